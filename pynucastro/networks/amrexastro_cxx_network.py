@@ -34,7 +34,8 @@ class AmrexAstroCxxNetwork(BaseCxxNetwork):
                                         'amrexastro-cxx-microphysics',
                                         '*.template')
 
-        return glob.glob(template_pattern)
+        # sorted, so the files are always processed in the same order
+        return sorted(glob.glob(template_pattern))
 
     def _rate_param_tests(self, n_indent, of):
 
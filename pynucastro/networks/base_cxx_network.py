@@ -5,15 +5,21 @@ comprised of the rates that are passed in.
 """
 
 
+import functools
+import json
 import os
 import re
 import shutil
+import struct
 import sys
+import warnings
+import zlib
 from abc import ABC, abstractmethod
 
 import numpy as np
 import sympy
 
+from pynucastro._version import version as pynucastro_version
 from pynucastro.networks.rate_collection import RateCollection
 from pynucastro.networks.sympy_network_support import SympyRates
 
@@ -24,17 +30,124 @@ class BaseCxxNetwork(ABC, RateCollection):
 
     """
 
+    # the stages of the evaluation marked in the templates when
+    # profiling, with their nesting level -- the batched entry points
+    # are only counted with batch_rhs
+    profile_stages = {"actual_rhs": 0, "actual_jac": 0,
+                      "evaluate_rates_batch": 0, "actual_rhs_batch": 0,
+                      "reaclib": 1, "screening": 1, "approx": 1, "tabular": 1,
+                      "rhs_nuc": 1, "jac_nuc": 1, "sneut5": 1}
+    profile_batch_stages = ("evaluate_rates_batch", "actual_rhs_batch")
+
     def __init__(self, *args, **kwargs):
         """Initialize the C++ network.  We take a single argument: a list
         of rate files that will make up the network
 
         """
 
+        # optional code generation features -- these are off by default,
+        # so the generated network is unchanged unless they are requested
+
+        # write the tabular rate data as a single preconverted binary
+        # file that is memory-mapped at init, with the ASCII tables
+        # kept as a fallback
+        binary_tables = kwargs.pop("binary_tables", False)
+
+        # write a batched version of the rate and righthand side
+        # evaluation that works on many zones at once
+        batch_rhs = kwargs.pop("batch_rhs", False)
+
+        # write a sparse Jacobian type with a compile-time nonzero
+        # pattern and an unrolled LU factorization and solve
+        sparse_jac = kwargs.pop("sparse_jac", False)
+
+        # how to factor out the common subexpressions in the righthand
+        # side and Jacobian: None writes each term in full, "fluxes"
+        # computes each reaction flux (and its derivatives) once as a
+        # temporary, and "sympy" runs sympy's cse over all of the terms
+        rhs_cse = kwargs.pop("rhs_cse", None)
+        if rhs_cse not in (None, "fluxes", "sympy"):
+            raise ValueError(f"unknown rhs_cse mode {rhs_cse}")
+
+        # find the cells of the tabular rate and partition function
+        # grids by index arithmetic (for uniform and log-uniform grids)
+        # or a table of hints, instead of searching
+        indexed_lookup = kwargs.pop("indexed_lookup", False)
+
+        # group the tabular rates that share a (T, rhoY) grid and
+        # evaluate each group in one pass from interleaved storage of
+        # the columns we use: True keeps the full tables as well, and
+        # "compact" reads the tables directly into the groups, dropping
+        # the unused columns
+        fused_tables = kwargs.pop("fused_tables", False)
+        if fused_tables not in (False, True, "compact"):
+            raise ValueError(f"unknown fused_tables mode {fused_tables}")
+
+        # mark the stages of the rate and righthand side evaluation with
+        # profiling counters -- these compile to nothing unless the
+        # network is built with USE_NETWORK_PROFILE=TRUE
+        profile = kwargs.pop("profile", False)
+
+        # tabulate ln(rate) and its derivative for the ReacLib (and
+        # derived) rates in ln(T9) at init, and interpolate them instead
+        # of evaluating the fits -- the spacing is chosen so the error
+        # in the rates is below reaclib_table_rtol
+        reaclib_table = kwargs.pop("reaclib_table", False)
+        reaclib_table_rtol = kwargs.pop("reaclib_table_rtol", 1.e-6)
+
+        # write a standalone, threaded CPU benchmark of actual_rhs()
+        # and actual_jac() over a stream of zones
+        benchmark = kwargs.pop("benchmark", False)
+
         super().__init__(*args, **kwargs)
 
+        self.binary_tables = binary_tables
+        self.binary_table_file = "tabular_rates.bin"
+
+        self.batch_rhs = batch_rhs
+
+        self.sparse_jac = sparse_jac
+
+        self.rhs_cse = rhs_cse
+
+        self.indexed_lookup = indexed_lookup
+
+        self.fused_tables = fused_tables
+
+        self.profile = profile
+
+        self.reaclib_table = reaclib_table
+        self.reaclib_table_rtol = reaclib_table_rtol
+        self.reaclib_table_T9_range = (1.e-2, 10.0)
+        self.reaclib_table_min_rate = 1.e-80
+        self.reaclib_table_max_npts = 16384
+
+        self.benchmark = benchmark
+
         # Get the template files for writing this network code
         self.template_files = self._get_template_files()
 
+        # template files that are only written if the named option is
+        # enabled -- the key is the template file basename
+        self.optional_templates = {}
+        self.optional_templates['table_rates_binary.H.template'] = 'binary_tables'
+        self.optional_templates['actual_rhs_batch.H.template'] = 'batch_rhs'
+        self.optional_templates['actual_jac_sparse.H.template'] = 'sparse_jac'
+        self.optional_templates['indexed_lookup.H.template'] = 'indexed_lookup'
+        self.optional_templates['table_rates_fused.H.template'] = 'fused_tables'
+        self.optional_templates['network_profile.H.template'] = 'profile'
+        self.optional_templates['reaclib_table.H.template'] = 'reaclib_table_enabled'
+        self.optional_templates['reaclib_table_data.cpp.template'] = 'reaclib_table_enabled'
+        self.optional_templates['network_benchmark.cpp.template'] = 'benchmark'
+        self.optional_templates['GNUmakefile.template'] = 'benchmark'
+        self.optional_templates['Make.benchmark.template'] = 'benchmark'
+
+        # optional templates that are standalone programs (and their
+        # build) -- these are written, but not added to the network's build
+        self.standalone_templates = {'network_benchmark.cpp.template',
+                                     'GNUmakefile.template',
+                                     'Make.benchmark.template'}
+
         self.symbol_rates = SympyRates()
 
         self.ydot_out_result = None
@@ -43,6 +156,12 @@ class BaseCxxNetwork(ABC, RateCollection):
         self.jac_null_entries = None
         self.solved_jacobian = False
 
+        # the nonzero pattern of the full Jacobian, and the elimination
+        # order and pattern (including the fill-in) of its LU factorization
+        self.jac_pattern = None
+        self.jac_lu_order = None
+        self.jac_lu_pattern = None
+
         self.function_specifier = "inline"
         self.dtype = "double"
 
@@ -60,20 +179,46 @@ class BaseCxxNetwork(ABC, RateCollection):
         self.ftags['<table_declare_meta>'] = self._table_declare_meta
         self.ftags['<table_init_meta>'] = self._table_init_meta
         self.ftags['<table_term_meta>'] = self._table_term_meta
+        self.ftags['<table_includes>'] = self._table_includes
+        self.ftags['<binary_table_file>'] = self._binary_table_file
+        self.ftags['<binary_tables_benchmark>'] = self._binary_tables_benchmark
         self.ftags['<compute_tabular_rates>'] = self._compute_tabular_rates
         self.ftags['<ydot>'] = self._ydot
         self.ftags['<enuc_add_energy_rate>'] = self._enuc_add_energy_rate
+        self.ftags['<enuc_add_energy_rate_batch>'] = functools.partial(self._enuc_add_energy_rate, rate_access="energy_rates")
         self.ftags['<jacnuc>'] = self._jacnuc
+        self.ftags['<sparse_jac_pattern>'] = self._sparse_jac_pattern
+        self.ftags['<sparse_lu_factor>'] = self._sparse_lu_factor
+        self.ftags['<sparse_lu_solve>'] = self._sparse_lu_solve
         self.ftags['<initial_mass_fractions>'] = self._initial_mass_fractions
         self.ftags['<pynucastro_home>'] = self._pynucastro_home
         self.ftags['<reaclib_rate_functions>'] = self._reaclib_rate_functions
         self.ftags['<rate_struct>'] = self._rate_struct
         self.ftags['<fill_reaclib_rates>'] = self._fill_reaclib_rates
+        self.ftags['<fill_reaclib_rates_batch>'] = self._fill_reaclib_rates_batch
         self.ftags['<approx_rate_functions>'] = self._approx_rate_functions
         self.ftags['<fill_approx_rates>'] = self._fill_approx_rates
         self.ftags['<part_fun_data>'] = self._fill_parition_function_data
         self.ftags['<part_fun_cases>'] = self._fill_parition_function_cases
         self.ftags['<spin_state_cases>'] = self._fill_spin_state_cases
+        self.ftags['<optional_files>'] = self._optional_files
+        self.ftags['<indexed_lookup_include>'] = self._indexed_lookup_include
+        self.ftags['<table_lookup_data>'] = self._table_lookup_data
+        self.ftags['<pf_lookup_data>'] = self._pf_lookup_data
+        self.ftags['<indexed_lookup_benchmark>'] = self._indexed_lookup_benchmark
+        self.ftags['<fused_tables_include>'] = self._fused_tables_include
+        self.ftags['<fused_tables_benchmark>'] = self._fused_tables_benchmark
+        self.ftags['<profile_include>'] = self._profile_include
+        self.ftags['<profile_counters>'] = self._profile_counters
+        self.ftags['<profile_init>'] = self._profile_init
+        self.ftags['<optional_defines>'] = self._optional_defines
+        self.ftags['<reaclib_table_include>'] = self._reaclib_table_include
+        self.ftags['<reaclib_table_params>'] = self._reaclib_table_params
+        self.ftags['<reaclib_table_init>'] = self._reaclib_table_init
+        self.ftags['<benchmark_network_info>'] = self._benchmark_network_info
+        for stage in self.profile_stages:
+            self.ftags[f'<profile_start_{stage}>'] = functools.partial(self._profile_marker, "START", stage)
+            self.ftags[f'<profile_stop_{stage}>'] = functools.partial(self._profile_marker, "STOP", stage)
         self.indent = '    '
 
         self.num_screen_calls = None
@@ -97,6 +242,12 @@ class BaseCxxNetwork(ABC, RateCollection):
         """
         # pylint: disable=arguments-differ
 
+        # there is nothing to tabulate without any ReacLib rates --
+        # this is checked here, since the rates can change after the
+        # network is created
+        if self.reaclib_table and not self.reaclib_table_enabled:
+            warnings.warn("the network has no ReacLib rates, so the ReacLib rate table is not written")
+
         # Prepare RHS terms
         if not self.solved_ydot:
             self.compose_ydot()
@@ -106,6 +257,8 @@ class BaseCxxNetwork(ABC, RateCollection):
         # Process template files
         for tfile in self.template_files:
             tfile_basename = os.path.basename(tfile)
+            if not self._template_enabled(tfile_basename):
+                continue
             outfile = tfile_basename.replace('.template', '')
             if odir is not None:
                 if not os.path.isdir(odir):
@@ -138,6 +291,84 @@ class BaseCxxNetwork(ABC, RateCollection):
                 else:
                     print(f'WARNING: Table data file {tr.table_file} not found.')
 
+        if self.binary_tables and self.tabular_rates:
+            self._write_binary_tables(odir)
+
+    def _template_enabled(self, tfile_basename):
+        """return whether a template file should be written -- optional
+        templates are only written if their option is enabled"""
+        option = self.optional_templates.get(tfile_basename)
+        return option is None or bool(getattr(self, option))
+
+    @property
+    def reaclib_table_enabled(self):
+        """whether the ReacLib rate table is used -- it is requested with
+        the reaclib_table option, but there is nothing to tabulate if
+        the network has no ReacLib rates"""
+        return bool(self.reaclib_table) and bool(self.reaclib_rates + self.derived_rates)
+
+    def _write_binary_tables(self, odir=None):
+        """
+        Write all of the tabular rate data into a single binary file
+        that the C++ init_tabular() can memory-map instead of parsing
+        the ASCII tables.  The layout is a 32-byte header, a directory
+        with one entry per table, and then the data for each table:
+        rhoy, temp, and the variables ordered as data(itemp, irhoy, ivar)
+        with temperature varying fastest.  Everything is little-endian,
+        and the header holds a CRC-32 of everything that follows it.
+        Each entry also records the size and modification time of the
+        ASCII table it was made from, so a binary file that is out of
+        date with the ASCII tables next to it is not used (this only
+        needs a stat() of each ASCII table at startup).
+        """
+
+        header_fmt = '<8sIIIIQ'
+        entry_fmt = '<32siiiIQQq'
+
+        directory_size = len(self.tabular_rates) * struct.calcsize(entry_fmt)
+        offset = struct.calcsize(header_fmt) + directory_size
+
+        entries = []
+        blocks = []
+        for r in self.tabular_rates:
+            tdata = r.tabular_data_table
+            nvars = r.table_num_vars
+            if tdata.shape != (r.table_rhoy_lines * r.table_temp_lines, nvars + 2):
+                raise ValueError(f'table {r.table_file} does not have the expected shape')
+            if len(r.table_index_name) >= 32:
+                raise ValueError(f'table name {r.table_index_name} is too long for the binary table directory')
+
+            # rows are ordered with temperature varying fastest
+            tdata = tdata.reshape(r.table_rhoy_lines, r.table_temp_lines, nvars + 2)
+            rhoy = tdata[:, 0, 0]
+            temp = tdata[0, :, 1]
+            data = np.transpose(tdata[:, :, 2:], (2, 0, 1))
+
+            block = np.concatenate((rhoy, temp, data.ravel())).astype('<f8').tobytes()
+
+            # the ASCII table that init_tabular() would read instead --
+            # the copy written with the network, if there is one
+            source = os.path.join(odir or os.getcwd(), r.table_file)
+            if not os.path.isfile(source):
+                source = r.table_path
+            source_stat = os.stat(source)
+
+            entries.append(struct.pack(entry_fmt, r.table_index_name.encode(),
+                                       r.table_temp_lines, r.table_rhoy_lines, nvars, 0,
+                                       offset, source_stat.st_size, int(source_stat.st_mtime)))
+            blocks.append(block)
+            offset += len(block)
+
+        payload = b''.join(entries + blocks)
+
+        header = struct.pack(header_fmt, b'PYNUCTAB', 0x01020304, 1,
+                             len(self.tabular_rates), zlib.crc32(payload),
+                             offset)
+
+        with open(os.path.join(odir or os.getcwd(), self.binary_table_file), "wb") as bf:
+            bf.write(header)
+            bf.write(payload)
+
     def compose_ydot(self):
         """create the expressions for dYdt for the nuclei, where Y is the
         molar fraction.
@@ -193,6 +424,65 @@ class BaseCxxNetwork(ABC, RateCollection):
         self.jac_null_entries = jac_null
         self.solved_jacobian = True
 
+        self.compose_jacobian_sparsity()
+
+    def compose_jacobian_sparsity(self):
+        """Find the nonzero pattern of the full Jacobian (the species
+        and the energy) and an elimination order for it, and the
+        pattern of its LU factorization in that order, including the
+        fill-in.  The indices here are 0-based, with the energy last.
+        """
+
+        nspec = len(self.unique_nuclei)
+        neqs = nspec + 1
+
+        # the species block comes from the symbolic Jacobian -- the
+        # energy row and column are dense, and we always keep the
+        # diagonal, since the integrator adds the identity to it
+        pattern = set()
+        for j in range(nspec):
+            for i in range(nspec):
+                if not self.jac_null_entries[nspec*j + i]:
+                    pattern.add((j, i))
+        for n in range(neqs):
+            pattern.add((n, n))
+            pattern.add((nspec, n))
+            pattern.add((n, nspec))
+
+        # order the elimination by minimum degree on the symmetrized
+        # pattern, to keep the fill-in small.  Ties go to the lower
+        # index, so the energy (which is coupled to everything) ends
+        # up last
+        adj = {n: set() for n in range(neqs)}
+        for i, j in pattern:
+            if i != j:
+                adj[i].add(j)
+                adj[j].add(i)
+
+        order = []
+        remaining = set(range(neqs))
+        while remaining:
+            k = min(remaining, key=lambda n: (len(adj[n]), n))
+            order.append(k)
+            remaining.remove(k)
+            for i in adj[k]:
+                adj[i].discard(k)
+                adj[i] |= adj[k] - {i}
+
+        # now do the symbolic factorization in that order
+        lu = set(pattern)
+        for kk, k in enumerate(order):
+            later = order[kk+1:]
+            rows = [i for i in later if (i, k) in lu]
+            cols = [j for j in later if (k, j) in lu]
+            for i in rows:
+                for j in cols:
+                    lu.add((i, j))
+
+        self.jac_pattern = pattern
+        self.jac_lu_order = order
+        self.jac_lu_pattern = lu
+
     def _compute_screening_factors(self, n_indent, of):
         screening_map = self.get_screening_map()
         for i, scr in enumerate(screening_map):
@@ -210,7 +500,9 @@ class BaseCxxNetwork(ABC, RateCollection):
                 # compiler to evaluate the screen factor at compile time.
                 of.write(f'\n{self.indent*(n_indent+1)}static_assert(scn_fac.z1 == {float(scr.n1.Z)}_rt);\n\n')
 
+                self._profile_marker("START", f"screen_{scr.name}", n_indent+1, of)
                 of.write(f'\n{self.indent*(n_indent+1)}actual_screen<do_T_derivatives>(pstate, scn_fac, scor, dscor_dt);\n')
+                self._profile_marker("STOP", f"screen_{scr.name}", n_indent+1, of)
 
                 of.write(f'{self.indent*n_indent}' + '}\n\n')
 
@@ -228,7 +520,9 @@ class BaseCxxNetwork(ABC, RateCollection):
 
                 of.write(f'\n{self.indent*(n_indent+1)}static_assert(scn_fac2.z1 == {float(scr.n1.Z)}_rt);\n\n')
 
+                self._profile_marker("START", f"screen_{scr.name}", n_indent+1, of)
                 of.write(f'\n{self.indent*(n_indent+1)}actual_screen<do_T_derivatives>(pstate, scn_fac2, scor2, dscor2_dt);\n')
+                self._profile_marker("STOP", f"screen_{scr.name}", n_indent+1, of)
 
                 of.write(f'\n{self.indent*n_indent}' + '}\n\n')
 
@@ -293,39 +587,140 @@ class BaseCxxNetwork(ABC, RateCollection):
     def _table_num(self, n_indent, of):
         of.write(f'{self.indent*n_indent}const int num_tables = {len(self.tabular_rates)};\n')
 
+    def _table_groups(self):
+        """return the tabular rates grouped by their (rhoy, T) grid, as a
+        list of lists -- the tables in a group have identical grids"""
+        groups = []
+        for r in self.tabular_rates:
+            rhoy, temp = self._table_grids(r)
+            for g in groups:
+                g_rhoy, g_temp = self._table_grids(g[0])
+                if np.array_equal(rhoy, g_rhoy) and np.array_equal(temp, g_temp):
+                    g.append(r)
+                    break
+            else:
+                groups.append([r])
+        return groups
+
+    def _table_group_declarations(self):
+        """return the declarations of the interleaved data of the table
+        groups, used by the fused table evaluation"""
+        decls = []
+        if self.fused_tables:
+            for ig, g in enumerate(self._table_groups(), start=1):
+                # the fused columns are rate, nuloss, and gamma
+                decls.append(f'AMREX_GPU_MANAGED Array3D<Real, 1, {3*len(g)}, 1, {g[0].table_temp_lines}, 1, {g[0].table_rhoy_lines}> table_group_{ig}_data;')
+        return decls
+
     def _declare_tables(self, n_indent, of):
         for r in self.tabular_rates:
             idnt = self.indent*n_indent
 
             of.write(f'{idnt}extern AMREX_GPU_MANAGED table_t {r.table_index_name}_meta;\n')
-            of.write(f'{idnt}extern AMREX_GPU_MANAGED Array3D<Real, 1, {r.table_temp_lines}, 1, {r.table_rhoy_lines}, 1, {r.table_num_vars}> {r.table_index_name}_data;\n')
+            if self.fused_tables != "compact":
+                of.write(f'{idnt}extern AMREX_GPU_MANAGED Array3D<Real, 1, {r.table_temp_lines}, 1, {r.table_rhoy_lines}, 1, {r.table_num_vars}> {r.table_index_name}_data;\n')
             of.write(f'{idnt}extern AMREX_GPU_MANAGED Array1D<Real, 1, {r.table_rhoy_lines}> {r.table_index_name}_rhoy;\n')
             of.write(f'{idnt}extern AMREX_GPU_MANAGED Array1D<Real, 1, {r.table_temp_lines}> {r.table_index_name}_temp;\n')
             of.write('\n')
 
+        for decl in self._table_group_declarations():
+            of.write(f'{self.indent*n_indent}extern {decl}\n')
+
     def _table_declare_meta(self, n_indent, of):
         for r in self.tabular_rates:
             idnt = self.indent*n_indent
 
             of.write(f"{idnt}AMREX_GPU_MANAGED table_t {r.table_index_name}_meta;\n")
 
-            of.write(f'{idnt}AMREX_GPU_MANAGED Array3D<Real, 1, {r.table_temp_lines}, 1, {r.table_rhoy_lines}, 1, {r.table_num_vars}> {r.table_index_name}_data;\n')
+            if self.fused_tables != "compact":
+                of.write(f'{idnt}AMREX_GPU_MANAGED Array3D<Real, 1, {r.table_temp_lines}, 1, {r.table_rhoy_lines}, 1, {r.table_num_vars}> {r.table_index_name}_data;\n')
 
             of.write(f'{idnt}AMREX_GPU_MANAGED Array1D<Real, 1, {r.table_rhoy_lines}> {r.table_index_name}_rhoy;\n')
             of.write(f'{idnt}AMREX_GPU_MANAGED Array1D<Real, 1, {r.table_temp_lines}> {r.table_index_name}_temp;\n\n')
 
+        for decl in self._table_group_declarations():
+            of.write(f'{self.indent*n_indent}{decl}\n')
+
     def _table_init_meta(self, n_indent, of):
+        idnt = self.indent*n_indent
+
+        if self.binary_tables and self.tabular_rates:
+            of.write(f'{idnt}auto start = std::chrono::steady_clock::now();\n\n')
+            of.write(f'{idnt}tab_blob_t blob(binary_table_file);\n')
+            of.write(f'{idnt}int nbinary = 0;\n\n')
+
+        # the group and position in the group of each table
+        group_index = {}
+        if self.fused_tables:
+            for ig, g in enumerate(self._table_groups(), start=1):
+                for it, r in enumerate(g, start=1):
+                    group_index[r] = (ig, it)
+
         for r in self.tabular_rates:
-            idnt = self.indent*n_indent
             of.write(f'{idnt}{r.table_index_name}_meta.ntemp = {r.table_temp_lines};\n')
             of.write(f'{idnt}{r.table_index_name}_meta.nrhoy = {r.table_rhoy_lines};\n')
             of.write(f'{idnt}{r.table_index_name}_meta.nvars = {r.table_num_vars};\n')
             of.write(f'{idnt}{r.table_index_name}_meta.nheader = {r.table_header_lines};\n\n')
 
-            of.write(f'{idnt}init_tab_info({r.table_index_name}_meta, "{r.table_file}", {r.table_index_name}_rhoy, {r.table_index_name}_temp, {r.table_index_name}_data);\n\n')
+            data = f'{r.table_index_name}_data'
+            if self.fused_tables == "compact":
+                # read the table directly into its group
+                ig, it = group_index[r]
+                data = f'{r.table_index_name}_group'
+                of.write(f'{idnt}auto {data} = table_group_column(table_group_{ig}_data, {it});\n')
+
+            if self.binary_tables:
+                of.write(f'{idnt}if (init_tab_info_binary(blob, {r.table_index_name}_meta, "{r.table_index_name}", "{r.table_file}",\n')
+                of.write(f'{idnt}                         {r.table_index_name}_rhoy, {r.table_index_name}_temp, {data})) {{\n')
+                of.write(f'{idnt}    ++nbinary;\n')
+                of.write(f'{idnt}}} else {{\n')
+                of.write(f'{idnt}    init_tab_info({r.table_index_name}_meta, "{r.table_file}", {r.table_index_name}_rhoy, {r.table_index_name}_temp, {data});\n')
+                of.write(f'{idnt}}}\n\n')
+            else:
+                of.write(f'{idnt}init_tab_info({r.table_index_name}_meta, "{r.table_file}", {r.table_index_name}_rhoy, {r.table_index_name}_temp, {data});\n\n')
+
+            if self.fused_tables is True:
+                ig, it = group_index[r]
+                of.write(f'{idnt}fill_table_group(table_group_{ig}_data, {it}, {r.table_index_name}_meta, {data});\n\n')
 
             of.write('\n')
 
+        if self.binary_tables and self.tabular_rates:
+            of.write(f'{idnt}std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;\n')
+            of.write(f'{idnt}amrex::Print() << "read " << num_tables << " tables (" << nbinary << " from "\n')
+            of.write(f'{idnt}               << binary_table_file << ") in " << elapsed.count() << " s" << std::endl;\n')
+
+    def _table_includes(self, n_indent, of):
+        if self.binary_tables:
+            of.write(f'{self.indent*n_indent}#include <chrono>\n')
+            of.write(f'{self.indent*n_indent}#include <table_rates_binary.H>\n')
+        self._fused_tables_include(n_indent, of)
+
+    def _binary_tables_benchmark(self, n_indent, of):
+        if not self.binary_tables:
+            return
+
+        idnt = self.indent*n_indent
+
+        of.write(f"{idnt}AMREX_INLINE\n")
+        of.write(f"{idnt}void binary_tables_benchmark (const int nrep)\n")
+        of.write(f"{idnt}{{\n\n")
+        of.write(f"{idnt}    // compare reading the tables from the ASCII files to reading\n")
+        of.write(f"{idnt}    // them from the binary file -- the tables are read into copies,\n")
+        of.write(f"{idnt}    // so this does not need (or change) the tables in use\n\n")
+        of.write(f"{idnt}    tab_blob_benchmark(binary_table_file, nrep);\n\n")
+        of.write(f"{idnt}    tab_blob_t blob(binary_table_file);\n\n")
+
+        for r in self.tabular_rates:
+            dims = f"{r.table_temp_lines}, {r.table_rhoy_lines}, {r.table_num_vars}"
+            of.write(f'{idnt}    binary_table_benchmark<{dims}>(blob, {{{dims}, {r.table_header_lines}}},\n')
+            of.write(f'{idnt}                                   "{r.table_index_name}", "{r.table_file}", nrep);\n')
+
+        of.write(f"\n{idnt}}}\n")
+
+    def _binary_table_file(self, n_indent, of):
+        of.write(f'{self.indent*n_indent}const std::string binary_table_file = "{self.binary_table_file}";\n')
+
     def _table_term_meta(self, n_indent, of):
         for r in self.tabular_rates:
 
@@ -354,10 +749,22 @@ class BaseCxxNetwork(ABC, RateCollection):
 
             idnt = self.indent*n_indent
 
+            if self.fused_tables:
+                self._compute_tabular_rates_fused(n_indent, of)
+                return
+
             for r in self.tabular_rates:
 
-                of.write(f'{idnt}tabular_evaluate({r.table_index_name}_meta, {r.table_index_name}_rhoy, {r.table_index_name}_temp, {r.table_index_name}_data,\n')
+                self._profile_marker("START", f"tabular_{r.table_index_name}", n_indent, of)
+                if self.indexed_lookup:
+                    of.write(f'{idnt}tabular_evaluate({r.table_index_name}_meta,\n')
+                    of.write(f'{idnt}                 indexed_grid({r.table_index_name}_rhoy, {r.table_index_name}_rhoy_lookup),\n')
+                    of.write(f'{idnt}                 indexed_grid({r.table_index_name}_temp, {r.table_index_name}_temp_lookup),\n')
+                    of.write(f'{idnt}                 {r.table_index_name}_data,\n')
+                else:
+                    of.write(f'{idnt}tabular_evaluate({r.table_index_name}_meta, {r.table_index_name}_rhoy, {r.table_index_name}_temp, {r.table_index_name}_data,\n')
                 of.write(f'{idnt}                 rhoy, state.T, rate, drate_dt, edot_nu, edot_gamma);\n')
+                self._profile_marker("STOP", f"tabular_{r.table_index_name}", n_indent, of)
 
                 of.write(f'{idnt}rate_eval.screened_rates(k_{r.cname()}) = rate;\n')
 
@@ -368,8 +775,193 @@ class BaseCxxNetwork(ABC, RateCollection):
                 of.write(f'{idnt}rate_eval.add_energy_rate(k_{r.cname()}) = edot_nu + edot_gamma;\n')
                 of.write('\n')
 
+    def _compute_tabular_rates_fused(self, n_indent, of):
+        idnt = self.indent*n_indent
+
+        for ig, g in enumerate(self._table_groups(), start=1):
+            r0 = g[0]
+            ntab = len(g)
+
+            of.write(f'{idnt}{{\n')
+            of.write(f'{idnt}    Real group_rate[{ntab}], group_drate_dt[{ntab}], group_edot_nu[{ntab}], group_edot_gamma[{ntab}];\n\n')
+
+            self._profile_marker("START", f"tabular_group_{ig}", n_indent+1, of)
+
+            if self.indexed_lookup:
+                of.write(f'{idnt}    tabular_evaluate_group<{ntab}>({r0.table_index_name}_meta,\n')
+                of.write(f'{idnt}                              indexed_grid({r0.table_index_name}_rhoy, {r0.table_index_name}_rhoy_lookup),\n')
+                of.write(f'{idnt}                              indexed_grid({r0.table_index_name}_temp, {r0.table_index_name}_temp_lookup),\n')
+                of.write(f'{idnt}                              table_group_{ig}_data,\n')
+            else:
+                of.write(f'{idnt}    tabular_evaluate_group<{ntab}>({r0.table_index_name}_meta, {r0.table_index_name}_rhoy, {r0.table_index_name}_temp, table_group_{ig}_data,\n')
+            of.write(f'{idnt}                              rhoy, state.T, group_rate, group_drate_dt, group_edot_nu, group_edot_gamma);\n')
+            self._profile_marker("STOP", f"tabular_group_{ig}", n_indent+1, of)
+            of.write('\n')
+
+            for it, r in enumerate(g):
+                of.write(f'{idnt}    rate_eval.screened_rates(k_{r.cname()}) = group_rate[{it}];\n')
+
+                of.write(f'{idnt}    if constexpr (std::is_same<T, rate_derivs_t>::value) {{\n')
+                of.write(f'{idnt}        rate_eval.dscreened_rates_dT(k_{r.cname()}) = group_drate_dt[{it}];\n')
+                of.write(f'{idnt}    }}\n')
+
+                of.write(f'{idnt}    rate_eval.add_energy_rate(k_{r.cname()}) = group_edot_nu[{it}] + group_edot_gamma[{it}];\n')
+                of.write('\n')
+
+            of.write(f'{idnt}}}\n\n')
+
+    def _fused_tables_include(self, n_indent, of):
+        if self.fused_tables:
+            of.write(f'{self.indent*n_indent}#include <table_rates_fused.H>\n')
+
+    def _fused_tables_benchmark(self, n_indent, of):
+        # the benchmark compares against the full tables, so it is only
+        # written if we keep them
+        if self.fused_tables is not True:
+            return
+
+        idnt = self.indent*n_indent
+
+        of.write(f"{idnt}AMREX_INLINE\n")
+        of.write(f"{idnt}void fused_tables_benchmark (const int nrep)\n")
+        of.write(f"{idnt}{{\n\n")
+        of.write(f"{idnt}    // compare evaluating the tables one at a time to evaluating\n")
+        of.write(f"{idnt}    // each group at once -- this needs the tables to be initialized first\n\n")
+        of.write(f"{idnt}    using namespace rate_tables;\n\n")
+
+        args = "const Real rhoy, const Real temp, Real* rate, Real* drate_dt, Real* edot_nu, Real* edot_gamma"
+
+        for ig, g in enumerate(self._table_groups(), start=1):
+            r0 = g[0]
+            ntab = len(g)
+            grid = f"{r0.table_index_name}_meta, {r0.table_index_name}_rhoy, {r0.table_index_name}_temp"
+
+            of.write(f'{idnt}    table_group_benchmark<{ntab}>("table group {ig}", {grid},\n')
+            of.write(f'{idnt}        [&] ({args}) {{\n')
+            for it, r in enumerate(g):
+                of.write(f'{idnt}            tabular_evaluate({r.table_index_name}_meta, {r.table_index_name}_rhoy, {r.table_index_name}_temp, {r.table_index_name}_data,\n')
+                of.write(f'{idnt}                             rhoy, temp, rate[{it}], drate_dt[{it}], edot_nu[{it}], edot_gamma[{it}]);\n')
+            of.write(f'{idnt}        }},\n')
+            of.write(f'{idnt}        [&] ({args}) {{\n')
+            of.write(f'{idnt}            tabular_evaluate_group<{ntab}>({grid}, table_group_{ig}_data,\n')
+            of.write(f'{idnt}                                          rhoy, temp, rate, drate_dt, edot_nu, edot_gamma);\n')
+            of.write(f'{idnt}        }},\n')
+            of.write(f'{idnt}        nrep);\n\n')
+
+        of.write(f"{idnt}}}\n")
+
+    def _profile_counters_list(self):
+        """return the profiling counters as (name, level, label) -- the
+        stages, plus each screening pair and each table (or group of
+        tables) within them"""
+        counters = []
+        for stage, level in self.profile_stages.items():
+            if stage in self.profile_batch_stages and not self.batch_rhs:
+                continue
+            counters.append((stage, level, stage))
+            if stage == "screening":
+                for scr in self.get_screening_map():
+                    counters.append((f"screen_{scr.name}", 2, f"{scr.n1} + {scr.n2}"))
+            elif stage == "tabular":
+                if self.fused_tables:
+                    for ig, g in enumerate(self._table_groups(), start=1):
+                        counters.append((f"tabular_group_{ig}", 2, f"group {ig} ({len(g)} tables)"))
+                else:
+                    for r in self.tabular_rates:
+                        counters.append((f"tabular_{r.table_index_name}", 2, r.table_index_name))
+        return counters
+
+    def _profile_marker(self, which, counter, n_indent, of):
+        # start or stop a profiling counter
+        if self.profile:
+            of.write(f'{self.indent*n_indent}NETWORK_PROFILE_{which}({counter});\n')
+
+    def _profile_include(self, n_indent, of):
+        if self.profile:
+            of.write(f'{self.indent*n_indent}#include <network_profile.H>\n')
+
+    def _profile_init(self, n_indent, of):
+        if self.profile:
+            of.write(f'{self.indent*n_indent}network_profile::init();\n')
+
+    def _profile_counters(self, n_indent, of):
+        idnt = self.indent*n_indent
+        counters = self._profile_counters_list()
+
+        of.write(f'{idnt}enum counter_t : int\n')
+        of.write(f'{idnt}{{\n')
+        for i, (name, _, _) in enumerate(counters):
+            of.write(f'{idnt}    {name}{" = 0" if i == 0 else ""},\n')
+        of.write(f'{idnt}    NumCounters\n')
+        of.write(f'{idnt}}};\n\n')
+
+        of.write(f'{idnt}constexpr const char* counter_names[NumCounters] = {{\n')
+        for _, _, label in counters:
+            of.write(f'{idnt}    "{label}",\n')
+        of.write(f'{idnt}}};\n\n')
+
+        levels = ", ".join(str(level) for _, level, _ in counters)
+        of.write(f'{idnt}constexpr int counter_level[NumCounters] = {{{levels}}};\n')
+
+    def _optional_defines(self, n_indent, of):
+        # the make variables for the enabled optional features
+        # -- note: Make.package uses a 2 space indent
+        if self.profile:
+            of.write(f'{"  "*n_indent}ifeq ($(USE_NETWORK_PROFILE),TRUE)\n')
+            of.write(f'{"  "*n_indent}  DEFINES += -DNETWORK_PROFILE\n')
+            of.write(f'{"  "*n_indent}endif\n')
+
+    def _ydot_rates(self):
+        """return the rates that contribute to the ydots, in the order
+        they first appear"""
+        rates = []
+        for n in self.unique_nuclei:
+            for rp in self.nuclei_rate_pairs[n]:
+                for r in (rp.forward, rp.reverse):
+                    if r is not None and r not in rates:
+                        rates.append(r)
+        return rates
+
+    def _flux_term(self, rate, n):
+        """return the C++ code for the contribution of rate's flux to the ydot
+        of nucleus n"""
+        c = rate.products.count(n) - rate.reactants.count(n)
+        term = sympy.sympify(c) * sympy.symbols(f"flux_{rate.cname()}")
+        return self.symbol_rates.cxxcode(term.evalf(n=self.symbol_rates.float_explicit_num_digits))
+
+    def _write_cse(self, n_indent, of, exprs):
+        """run sympy's common subexpression elimination over exprs, write
+        the temporaries, and return the C++ code for the reduced expressions"""
+        replacements, reduced = sympy.cse(exprs, symbols=sympy.numbered_symbols("cse"))
+        for sym, expr in replacements:
+            of.write(f"{self.indent*n_indent}const Real {sym} = {self.symbol_rates.cxxcode(expr)};\n")
+        if replacements:
+            of.write("\n")
+        return [self.symbol_rates.cxxcode(expr) for expr in reduced]
+
     def _ydot(self, n_indent, of):
         # Write YDOT
+
+        if self.rhs_cse == "sympy":
+            exprs = [sum(t for pair in self.ydot_out_result[n] for t in pair if t is not None)
+                     for n in self.unique_nuclei if self.ydot_out_result[n] is not None]
+            values = iter(self._write_cse(n_indent, of, exprs))
+            for n in self.unique_nuclei:
+                if self.ydot_out_result[n] is None:
+                    of.write(f"{self.indent*n_indent}{self.symbol_rates.name_ydot_nuc}({n.cindex()}) = 0.0;\n\n")
+                else:
+                    of.write(f"{self.indent*n_indent}{self.symbol_rates.name_ydot_nuc}({n.cindex()}) =\n")
+                    of.write(f"{2*self.indent*n_indent}{next(values)};\n\n")
+            return
+
+        if self.rhs_cse == "fluxes":
+            # each reaction flux is computed once, and then the ydots
+            # are sums of the fluxes
+            for r in self._ydot_rates():
+                flux = self.symbol_rates.specific_rate_symbol(r).evalf(n=self.symbol_rates.float_explicit_num_digits)
+                of.write(f"{self.indent*n_indent}const Real flux_{r.cname()} = {self.symbol_rates.cxxcode(flux)};\n")
+            of.write("\n")
+
         for n in self.unique_nuclei:
             if self.ydot_out_result[n] is None:
                 of.write(f"{self.indent*n_indent}{self.symbol_rates.name_ydot_nuc}({n.cindex()}) = 0.0;\n\n")
@@ -391,20 +983,23 @@ class BaseCxxNetwork(ABC, RateCollection):
                 if num == 2:
                     of.write("(")
 
-                if pair[0] is not None:
-                    sol_value = self.symbol_rates.cxxify(sympy.cxxcode(pair[0], precision=15,
-                                                                       standard="c++11"))
+                if self.rhs_cse == "fluxes":
+                    rp = self.nuclei_rate_pairs[n][j]
+                    terms = [self._flux_term(r, n) if r is not None else None
+                             for r in (rp.forward, rp.reverse)]
+                else:
+                    terms = [self.symbol_rates.cxxify(sympy.cxxcode(t, precision=15,
+                                                                    standard="c++11")) if t is not None else None
+                             for t in pair]
 
-                    of.write(f"{sol_value}")
+                if terms[0] is not None:
+                    of.write(f"{terms[0]}")
 
                 if num == 2:
                     of.write(" + ")
 
-                if pair[1] is not None:
-                    sol_value = self.symbol_rates.cxxify(sympy.cxxcode(pair[1], precision=15,
-                                                                       standard="c++11"))
-
-                    of.write(f"{sol_value}")
+                if terms[1] is not None:
+                    of.write(f"{terms[1]}")
 
                 if num == 2:
                     of.write(")")
@@ -414,9 +1009,9 @@ class BaseCxxNetwork(ABC, RateCollection):
                 else:
                     of.write(" +\n")
 
-    def _enuc_add_energy_rate(self, n_indent, of):
+    def _enuc_add_energy_rate(self, n_indent, of, rate_access="rate_eval.add_energy_rate"):
         # Add tabular per-reaction neutrino energy generation rates to the energy generation rate
-        # (not thermal neutrinos)
+        # (not thermal neutrinos) -- rate_access is how the energy rates are indexed
 
         idnt = self.indent * n_indent
 
@@ -425,11 +1020,27 @@ class BaseCxxNetwork(ABC, RateCollection):
                 sys.exit('ERROR: Unknown energy rate corrections for a reaction where the number of reactants is not 1.')
             else:
                 reactant = r.reactants[0]
-                of.write(f'{idnt}enuc += C::Legacy::n_A * {self.symbol_rates.name_y}({reactant.cindex()}) * rate_eval.add_energy_rate(k_{r.cname()});\n')
+                of.write(f'{idnt}enuc += C::Legacy::n_A * {self.symbol_rates.name_y}({reactant.cindex()}) * {rate_access}(k_{r.cname()});\n')
 
     def _jacnuc(self, n_indent, of):
         # now make the Jacobian
+
+        if self.rhs_cse == "fluxes":
+            self._jacnuc_fluxes(n_indent, of)
+            return
+
         n_unique_nuclei = len(self.unique_nuclei)
+
+        if self.rhs_cse == "sympy":
+            entries = [(nj, ni) for nj in self.unique_nuclei for ni in self.unique_nuclei]
+            entries = [(e, self.jac_out_result[idx]) for idx, e in enumerate(entries)
+                       if not self.jac_null_entries[idx]]
+            values = self._write_cse(n_indent, of, [expr for _, expr in entries])
+            for ((nj, ni), _), jvalue in zip(entries, values):
+                of.write(f"{self.indent*(n_indent)}scratch = {jvalue};\n")
+                of.write(f"{self.indent*n_indent}jac.set({nj.cindex()}, {ni.cindex()}, scratch);\n\n")
+            return
+
         for jnj, nj in enumerate(self.unique_nuclei):
             for ini, ni in enumerate(self.unique_nuclei):
                 jac_idx = n_unique_nuclei*jnj + ini
@@ -439,6 +1050,153 @@ class BaseCxxNetwork(ABC, RateCollection):
                     of.write(f"{self.indent*(n_indent)}scratch = {jvalue};\n")
                     of.write(f"{self.indent*n_indent}jac.set({nj.cindex()}, {ni.cindex()}, scratch);\n\n")
 
+    def _jacnuc_fluxes(self, n_indent, of):
+        # the derivative of each reaction flux with respect to each of
+        # its reactants is computed once, and then the Jacobian elements
+        # are sums of these
+
+        idnt = self.indent*n_indent
+        ndigits = self.symbol_rates.float_explicit_num_digits
+
+        dflux = {}
+        for r in self._ydot_rates():
+            flux = self.symbol_rates.specific_rate_symbol(r)
+            for ni in self.unique_nuclei:
+                if ni not in r.reactants:
+                    continue
+                name = f"dflux_{r.cname()}_d{ni.cindex()}"
+                dflux[(r, ni)] = sympy.symbols(name)
+                deriv = sympy.diff(flux, sympy.symbols(f"Y__j{ni}__")).evalf(n=ndigits)
+                of.write(f"{idnt}const Real {name} = {self.symbol_rates.cxxcode(deriv)};\n")
+        of.write("\n")
+
+        n_unique_nuclei = len(self.unique_nuclei)
+        for jnj, nj in enumerate(self.unique_nuclei):
+            for ini, ni in enumerate(self.unique_nuclei):
+                if self.jac_null_entries[n_unique_nuclei*jnj + ini]:
+                    continue
+                jsym = 0
+                for rp in self.nuclei_rate_pairs[nj]:
+                    for r in (rp.forward, rp.reverse):
+                        if r is not None and (r, ni) in dflux:
+                            c = r.products.count(nj) - r.reactants.count(nj)
+                            jsym += sympy.sympify(c) * dflux[(r, ni)]
+                jvalue = self.symbol_rates.cxxcode(sympy.sympify(jsym).evalf(n=ndigits))
+                of.write(f"{idnt}scratch = {jvalue};\n")
+                of.write(f"{idnt}jac.set({nj.cindex()}, {ni.cindex()}, scratch);\n\n")
+
+    def _sparse_jac_storage(self):
+        """return the CSR row pointers, the (0-based) column of each
+        stored element, and a dict mapping (row, col) to its position
+        in the storage"""
+
+        neqs = len(self.unique_nuclei) + 1
+        row_ptr = [0]
+        cols = []
+        position = {}
+        for i in range(neqs):
+            for j in range(neqs):
+                if (i, j) in self.jac_lu_pattern:
+                    position[(i, j)] = len(cols)
+                    cols.append(j)
+            row_ptr.append(len(cols))
+        return row_ptr, cols, position
+
+    def _sparse_jac_pattern(self, n_indent, of):
+        if not self.solved_jacobian:
+            self.compose_jacobian()
+
+        idnt = self.indent*n_indent
+        neqs = len(self.unique_nuclei) + 1
+        row_ptr, cols, position = self._sparse_jac_storage()
+
+        nnz = len(self.jac_pattern)
+
+        # the arrays are indexed at runtime in device code, so they are
+        # declared like the partition function data
+        decl = "MICROPHYSICS_UNUSED HIP_CONSTEXPR static AMREX_GPU_MANAGED int"
+
+        of.write(f"{idnt}// {nnz} of the {neqs*neqs} Jacobian elements can be nonzero, and the\n")
+        of.write(f"{idnt}// LU factorization adds {len(cols) - nnz} more\n\n")
+
+        of.write(f"{idnt}constexpr int jac_lu_nnz = {len(cols)};\n\n")
+
+        of.write(f"{idnt}// the order in which the equations are eliminated\n")
+        of.write(f"{idnt}{decl} jac_lu_order[neqs] = {{{', '.join(str(k+1) for k in self.jac_lu_order)}}};\n\n")
+
+        of.write(f"{idnt}// the stored elements, in compressed sparse row form\n")
+        of.write(f"{idnt}{decl} jac_csr_row_ptr[neqs+1] = {{{', '.join(str(p) for p in row_ptr)}}};\n\n")
+        of.write(f"{idnt}{decl} jac_csr_col_index[jac_lu_nnz] =\n{idnt}{{\n")
+        for i in range(neqs):
+            row = ', '.join(str(j+1) for j in cols[row_ptr[i]:row_ptr[i+1]])
+            sep = ',' if i < neqs-1 else ''
+            of.write(f"{idnt}    {row}{sep}\n")
+        of.write(f"{idnt}}};\n\n")
+
+        of.write(f"{idnt}// the position of element (i, j) in the storage, or -1 if it is\n")
+        of.write(f"{idnt}// always zero, indexed as (i-1) * neqs + (j-1)\n")
+        of.write(f"{idnt}{decl} jac_lu_index[neqs*neqs] =\n{idnt}{{\n")
+        for i in range(neqs):
+            row = ', '.join(str(position.get((i, j), -1)) for j in range(neqs))
+            sep = ',' if i < neqs-1 else ''
+            of.write(f"{idnt}    {row}{sep}\n")
+        of.write(f"{idnt}}};\n")
+
+    def _sparse_lu_factor(self, n_indent, of):
+        # The elimination order is fixed when the network is written, so
+        # there is no pivoting.  This assumes the matrix is diagonally
+        # dominant, as the Newton matrix I - gamma J is for the
+        # timesteps the integrator takes (each diagonal element is 1 +
+        # gamma times the destruction rate of that species).  Each pivot
+        # is still checked, and the factorization returns the equation
+        # of the first one that has cancelled to roundoff.
+        if not self.solved_jacobian:
+            self.compose_jacobian()
+
+        idnt = self.indent*n_indent
+        _, _, position = self._sparse_jac_storage()
+        lu = self.jac_lu_pattern
+
+        of.write(f"{idnt}Real inv_pivot;\n")
+        for kk, k in enumerate(self.jac_lu_order):
+            later = self.jac_lu_order[kk+1:]
+            rows = [i for i in later if (i, k) in lu]
+            cols = [j for j in later if (k, j) in lu]
+            of.write(f"\n{idnt}if (std::abs(a[{position[(k, k)]}]) <= pivot_tol[{k}]) {{\n")
+            of.write(f"{idnt}    return {k+1};\n")
+            of.write(f"{idnt}}}\n")
+            if not rows:
+                continue
+            of.write(f"{idnt}// eliminate equation {k+1}\n")
+            of.write(f"{idnt}inv_pivot = 1.0_rt / a[{position[(k, k)]}];\n")
+            for i in rows:
+                of.write(f"{idnt}a[{position[(i, k)]}] *= inv_pivot;\n")
+                for j in cols:
+                    of.write(f"{idnt}a[{position[(i, j)]}] -= a[{position[(i, k)]}] * a[{position[(k, j)]}];\n")
+
+    def _sparse_lu_solve(self, n_indent, of):
+        if not self.solved_jacobian:
+            self.compose_jacobian()
+
+        idnt = self.indent*n_indent
+        _, _, position = self._sparse_jac_storage()
+        lu = self.jac_lu_pattern
+        order = self.jac_lu_order
+
+        of.write(f"{idnt}// forward substitution with L (which has a unit diagonal)\n")
+        for kk, k in enumerate(order):
+            for i in order[kk+1:]:
+                if (i, k) in lu:
+                    of.write(f"{idnt}b({i+1}) -= a[{position[(i, k)]}] * b({k+1});\n")
+
+        of.write(f"\n{idnt}// back substitution with U\n")
+        for kk in reversed(range(len(order))):
+            k = order[kk]
+            for j in order[kk+1:]:
+                if (k, j) in lu:
+                    of.write(f"{idnt}b({k+1}) -= a[{position[(k, j)]}] * b({j+1});\n")
+            of.write(f"{idnt}b({k+1}) /= a[{position[(k, k)]}];\n")
+
     def _initial_mass_fractions(self, n_indent, of):
         for i, _ in enumerate(self.unique_nuclei):
             if i == 0:
@@ -446,6 +1204,21 @@ class BaseCxxNetwork(ABC, RateCollection):
             else:
                 of.write(f"{self.indent*n_indent}unit_test.X{i+1} = 0.0\n")
 
+    def _optional_files(self, n_indent, of):
+        # add the files from any enabled optional templates to the build
+        # -- note: Make.package uses a 2 space indent
+        for tfile in self.template_files:
+            tfile_basename = os.path.basename(tfile)
+            if tfile_basename not in self.optional_templates or not self._template_enabled(tfile_basename):
+                continue
+            if tfile_basename in self.standalone_templates:
+                continue
+            outfile = tfile_basename.replace('.template', '')
+            if outfile.endswith('.H'):
+                of.write(f'{"  "*n_indent}CEXE_headers += {outfile}\n')
+            elif outfile.endswith('.cpp'):
+                of.write(f'{"  "*n_indent}CEXE_sources += {outfile}\n')
+
     def _pynucastro_home(self, n_indent, of):
         of.write('{}PYNUCASTRO_HOME := {}\n'.format(self.indent*n_indent,
                                                     os.path.dirname(self.pynucastro_dir)))
@@ -476,6 +1249,10 @@ class BaseCxxNetwork(ABC, RateCollection):
             of.write(r.function_string_cxx(dtype=self.dtype, specifiers=self.function_specifier))
 
     def _fill_reaclib_rates(self, n_indent, of):
+        if self.reaclib_table_enabled:
+            of.write(f"{self.indent*n_indent}if (fill_reaclib_rates_tabulated<do_T_derivatives, T>(tfactors, rate_eval)) {{\n")
+            of.write(f"{self.indent*n_indent}    return;\n")
+            of.write(f"{self.indent*n_indent}}}\n\n")
         for r in self.reaclib_rates + self.derived_rates:
             of.write(f"{self.indent*n_indent}rate_{r.cname()}<do_T_derivatives>(tfactors, rate, drate_dT);\n")
             of.write(f"{self.indent*n_indent}rate_eval.screened_rates(k_{r.cname()}) = rate;\n")
@@ -483,6 +1260,139 @@ class BaseCxxNetwork(ABC, RateCollection):
             of.write(f"{self.indent*n_indent}    rate_eval.dscreened_rates_dT(k_{r.cname()}) = drate_dT;\n\n")
             of.write(f"{self.indent*n_indent}}}\n")
 
+    @staticmethod
+    def reaclib_ln_rate(r, lnT9):
+        """return ln(rate) and d ln(rate) / d ln(T9) of the ReacLib rate
+        r at the points lnT9, evaluating its sets as the C++ rate
+        functions do (but without any partition functions)"""
+
+        lnT9 = np.asarray(lnT9, dtype=np.float64)
+        T9 = np.exp(lnT9)
+
+        ln_sets = []
+        dln_sets = []
+        for s in r.sets:
+            a = s.a
+            ln_sets.append(np.maximum(a[0] + a[1] / T9 + a[2] * T9**(-1.0/3.0) + a[3] * T9**(1.0/3.0) +
+                                      a[4] * T9 + a[5] * T9**(5.0/3.0) + a[6] * lnT9, -230.0))
+            dln_sets.append(-a[1] / T9 - a[2] / 3.0 * T9**(-1.0/3.0) + a[3] / 3.0 * T9**(1.0/3.0) +
+                            a[4] * T9 + 5.0 / 3.0 * a[5] * T9**(5.0/3.0) + a[6])
+
+        ln_rate = np.logaddexp.reduce(np.array(ln_sets), axis=0)
+        dln_rate = np.sum(np.exp(np.array(ln_sets) - ln_rate) * np.array(dln_sets), axis=0)
+
+        return ln_rate, dln_rate
+
+    def reaclib_table_npts(self):
+        """return the number of points for the ReacLib rate table, and
+        the largest interpolation error in ln(rate) it gives.  Below
+        reaclib_table_min_rate, the error is measured relative to
+        reaclib_table_min_rate instead of the rate itself.  The points
+        are increased until the error is at most half of
+        reaclib_table_rtol (the partition functions of the derived rates
+        are not included here, but they are in the check done at init)."""
+
+        x_lo, x_hi = np.log(self.reaclib_table_T9_range)
+        ln_min_rate = np.log(self.reaclib_table_min_rate)
+        rates = self.reaclib_rates + self.derived_rates
+
+        npts = 128
+        while True:
+            x, dx = np.linspace(x_lo, x_hi, npts, retstep=True)
+
+            err = 0.0
+            for r in rates:
+                y, m = self.reaclib_ln_rate(r, x)
+                for t in (0.25, 0.5, 0.75):
+                    y_exact, _ = self.reaclib_ln_rate(r, x[:-1] + t * dx)
+                    y_interp = ((2*t**3 - 3*t**2 + 1) * y[:-1] + (t**3 - 2*t**2 + t) * dx * m[:-1] +
+                                (3*t**2 - 2*t**3) * y[1:] + (t**3 - t**2) * dx * m[1:])
+                    diff = np.abs(y_interp - y_exact) * np.exp(np.minimum(y_exact - ln_min_rate, 0.0))
+                    err = max(err, diff.max(initial=0.0))
+
+            if err <= 0.5 * self.reaclib_table_rtol:
+                return npts, err
+
+            if npts >= self.reaclib_table_max_npts:
+                print(f"WARNING: the ReacLib rate table is limited to {npts} points, "
+                      f"with an error of {err:.3g} for reaclib_table_rtol = {self.reaclib_table_rtol:.3g}")
+                return npts, err
+
+            npts = min(int(1.25 * npts), self.reaclib_table_max_npts)
+
+    def _reaclib_table_include(self, n_indent, of):
+        if self.reaclib_table_enabled:
+            of.write(f'{self.indent*n_indent}#include <reaclib_table.H>\n')
+
+    def _reaclib_table_params(self, n_indent, of):
+        idnt = self.indent*n_indent
+
+        npts, err = self.reaclib_table_npts()
+        x_lo, x_hi = np.log(self.reaclib_table_T9_range)
+
+        of.write(f"{idnt}// the table spans T9 = {self.reaclib_table_T9_range[0]} to {self.reaclib_table_T9_range[1]}, ")
+        of.write(f"and pynucastro estimated its largest error in ln(rate) as {err:.3g}\n")
+        of.write(f"{idnt}constexpr int reaclib_table_npts = {npts};\n")
+        of.write(f"{idnt}constexpr Real reaclib_table_lnT9_lo = {float(x_lo)!r}_rt;\n")
+        of.write(f"{idnt}constexpr Real reaclib_table_lnT9_hi = {float(x_hi)!r}_rt;\n")
+        of.write(f"{idnt}constexpr Real reaclib_table_rtol = {float(self.reaclib_table_rtol)!r}_rt;\n")
+        of.write(f"{idnt}constexpr Real reaclib_table_min_rate = {float(self.reaclib_table_min_rate)!r}_rt;\n")
+        of.write(f"{idnt}constexpr int reaclib_table_size = reaclib_table_npts * NrateReaclib;\n\n")
+
+        of.write(f"{idnt}// the rate index of each column of the table\n")
+        of.write(f"{idnt}MICROPHYSICS_UNUSED HIP_CONSTEXPR static AMREX_GPU_MANAGED int reaclib_table_rate_index[NrateReaclib] = {{\n")
+        rates = self.reaclib_rates + self.derived_rates
+        for i, r in enumerate(rates):
+            sep = "," if i < len(rates) - 1 else ""
+            of.write(f"{idnt}    k_{r.cname()}{sep}\n")
+        of.write(f"{idnt}}};\n")
+
+    def _reaclib_table_init(self, n_indent, of):
+        if self.reaclib_table_enabled:
+            of.write(f"{self.indent*n_indent}init_reaclib_table();\n")
+
+    def benchmark_options(self):
+        """return the code generation options this network was written
+        with, as recorded by the benchmark"""
+        return {"binary_tables": bool(self.binary_tables),
+                "batch_rhs": bool(self.batch_rhs),
+                "sparse_jac": bool(self.sparse_jac),
+                "rhs_cse": self.rhs_cse,
+                "indexed_lookup": bool(self.indexed_lookup),
+                "fused_tables": self.fused_tables,
+                "profile": bool(self.profile),
+                "reaclib_table": self.reaclib_table_enabled}
+
+    def _benchmark_network_info(self, n_indent, of):
+        # how this network was written, for the benchmark report
+        idnt = self.indent*n_indent
+        options = json.dumps(self.benchmark_options())
+        of.write(f'{idnt}constexpr const char* benchmark_pynucastro_version = "{pynucastro_version}";\n')
+        of.write(f'{idnt}constexpr const char* benchmark_network_options = R"({options})";\n')
+
+    def _fill_reaclib_rates_batch(self, n_indent, of):
+        idnt = self.indent*n_indent
+
+        if self.reaclib_table_enabled:
+            # the table interpolation is already vectorized over the
+            # rates, so each zone is filled as evaluate_rates() does,
+            # including the fallback to the fits outside of the table
+            of.write(f"{idnt}for (int z = 0; z < nb; ++z) {{\n")
+            of.write(f"{idnt}    T rate_eval{{{{&screened_rates[z], stride}}, {{&add_energy_rate[z], aer_stride}}}};\n")
+            of.write(f"{idnt}    fill_reaclib_rates<do_T_derivatives, T>(tfactors(z), rate_eval);\n")
+            of.write(f"{idnt}}}\n\n")
+            return
+
+        # each rate is evaluated for all of the zones in the block, with
+        # the zone loop innermost so it can be vectorized
+        for r in self.reaclib_rates + self.derived_rates:
+            of.write(f"{idnt}AMREX_PRAGMA_SIMD\n")
+            of.write(f"{idnt}for (int z = 0; z < nb; ++z) {{\n")
+            of.write(f"{idnt}    Real rate, drate_dT;\n")
+            of.write(f"{idnt}    rate_{r.cname()}<do_T_derivatives>(tfactors(z), rate, drate_dT);\n")
+            of.write(f"{idnt}    screened_rates[(k_{r.cname()}-1) * stride + z] = rate;\n")
+            of.write(f"{idnt}}}\n\n")
+
     def _fill_approx_rates(self, n_indent, of):
         for r in self.approx_rates:
             of.write(f"{self.indent*n_indent}rate_{r.cname()}<T>(rate_eval, rate, drate_dT);\n")
@@ -552,9 +1462,119 @@ class BaseCxxNetwork(ABC, RateCollection):
             if n.partition_function:
 
                 of.write(f"{self.indent*n_indent}case {n.cindex()}:\n")
-                of.write(f"{self.indent*2*n_indent}part_fun::interpolate_pf(tfactors.T9, part_fun::{n}_npts, part_fun::{n}_temp_array, part_fun::{n}_pf_array, pf, dpf_dT);\n")
+                if self.indexed_lookup:
+                    of.write(f"{self.indent*2*n_indent}part_fun::interpolate_pf_indexed(tfactors.T9, part_fun::{n}_temp_lookup, part_fun::{n}_temp_array, part_fun::{n}_pf_array, pf, dpf_dT);\n")
+                else:
+                    of.write(f"{self.indent*2*n_indent}part_fun::interpolate_pf(tfactors.T9, part_fun::{n}_npts, part_fun::{n}_temp_array, part_fun::{n}_pf_array, pf, dpf_dT);\n")
                 of.write(f"{self.indent*2*n_indent}break;\n\n")
 
+    @staticmethod
+    def grid_log2(x):
+        """the approximate log2 used for the hints of grids spanning many
+        decades -- this must match grid_log2() in indexed_lookup.H"""
+        bits = np.asarray(x, dtype=np.float64).view(np.uint64)
+        return bits.astype(np.float64) * 2.0**-52 - 1023.0
+
+    @staticmethod
+    def grid_lookup(x, nhint=128, rtol=1.e-4):
+        """classify the (increasing) grid x for the C++ grid_lookup_t,
+        returning the kind, the start and inverse spacing (in x,
+        log10(x), or grid_log2(x)), and the 1-based hints for a general
+        grid (or None)"""
+
+        x = np.asarray(x, dtype=np.float64)
+        npts = len(x)
+
+        def is_uniform(s):
+            ds = np.diff(s)
+            return np.all(np.abs(ds - ds.mean()) <= rtol * abs(ds.mean()))
+
+        if is_uniform(x):
+            return "grid_uniform", x[0], (npts - 1) / (x[-1] - x[0]), None
+
+        use_log = x[0] > 0.0 and x[-1] / x[0] > 100.0
+
+        if use_log and is_uniform(np.log10(x)):
+            return "grid_log_uniform", np.log10(x[0]), (npts - 1) / (np.log10(x[-1]) - np.log10(x[0])), None
+
+        # for anything else, store the cell containing the start of
+        # each of nhint evenly spaced hints, so only a few points need
+        # to be stepped over
+        s = BaseCxxNetwork.grid_log2(x) if use_log else x
+        inv_ds = nhint / (s[-1] - s[0])
+        edges = s[0] + np.arange(nhint) / inv_ds
+        hints = np.clip(np.searchsorted(s, edges, side="right"), 1, npts - 1)
+
+        kind = "grid_general_log" if use_log else "grid_general_lin"
+        return kind, s[0], inv_ds, [int(h) for h in hints]
+
+    def _write_grid_lookup(self, n_indent, of, name, x):
+        idnt = self.indent*n_indent
+        kind, s0, inv_ds, hints = self.grid_lookup(x)
+
+        decl = "MICROPHYSICS_UNUSED HIP_CONSTEXPR static AMREX_GPU_MANAGED grid_lookup_t"
+
+        if hints is None:
+            of.write(f"{idnt}{decl} {name} = {{{kind}, {len(x)}, {float(s0)!r}, {float(inv_ds)!r}, {{}}}};\n\n")
+            return
+
+        of.write(f"{idnt}{decl} {name} = {{{kind}, {len(x)}, {float(s0)!r}, {float(inv_ds)!r},\n")
+        of.write(f"{2*idnt}{{\n")
+        for i in range(0, len(hints), 16):
+            sep = "," if i + 16 < len(hints) else ""
+            of.write(f"{3*idnt}{', '.join(str(h) for h in hints[i:i+16])}{sep}\n")
+        of.write(f"{2*idnt}}}\n")
+        of.write(f"{idnt}}};\n\n")
+
+    def _table_grids(self, r):
+        """return the rhoy and temperature grids of tabular rate r"""
+        tdata = r.tabular_data_table
+        return tdata[::r.table_temp_lines, 0], tdata[:r.table_temp_lines, 1]
+
+    def _indexed_lookup_include(self, n_indent, of):
+        if self.indexed_lookup:
+            of.write(f'{self.indent*n_indent}#include <indexed_lookup.H>\n')
+
+    def _table_lookup_data(self, n_indent, of):
+        for r in self.tabular_rates:
+            rhoy, temp = self._table_grids(r)
+            self._write_grid_lookup(n_indent, of, f"{r.table_index_name}_rhoy_lookup", rhoy)
+            self._write_grid_lookup(n_indent, of, f"{r.table_index_name}_temp_lookup", temp)
+
+    def _pf_lookup_data(self, n_indent, of):
+        for n in self.get_nuclei_needing_partition_functions():
+            if n.partition_function:
+                self._write_grid_lookup(n_indent, of, f"{n}_temp_lookup",
+                                        n.partition_function.temperature/1.0e9)
+
+    def _indexed_lookup_benchmark(self, n_indent, of):
+        if not self.indexed_lookup:
+            return
+
+        idnt = self.indent*n_indent
+
+        of.write(f"{idnt}AMREX_INLINE\n")
+        of.write(f"{idnt}void indexed_lookup_benchmark (const int nrep)\n")
+        of.write(f"{idnt}{{\n\n")
+        of.write(f"{idnt}    // compare the cost of the grid lookups to the searches they\n")
+        of.write(f"{idnt}    // replace -- this needs the tables to be initialized first\n\n")
+
+        for r in self.tabular_rates:
+            for var, npts in (("rhoy", r.table_rhoy_lines), ("temp", r.table_temp_lines)):
+                grid = f"rate_tables::{r.table_index_name}_{var}"
+                of.write(f'{idnt}    grid_lookup_benchmark("{r.table_index_name} {var}", {grid}_lookup, {grid},\n')
+                of.write(f'{idnt}                          [&] (const Real x) {{ return vector_index_lu({npts}, {grid}, x); }}, nrep);\n')
+
+        for n in self.get_nuclei_needing_partition_functions():
+            if n.partition_function:
+                of.write(f"{idnt}    {{\n")
+                of.write(f"{idnt}        auto temp = [] (const int i) -> Real {{ return part_fun::{n}_temp_array[i-1]; }};\n")
+                of.write(f'{idnt}        grid_lookup_benchmark("{n} partition function T9", part_fun::{n}_temp_lookup, temp,\n')
+                of.write(f'{idnt}                              [&] (const Real x) {{ return linear_index_lu(part_fun::{n}_npts, temp, x); }}, nrep);\n')
+                of.write(f"{idnt}    }}\n")
+
+        of.write(f"\n{idnt}}}\n")
+
     def _fill_spin_state_cases(self, n_indent, of):
 
         for n in self.unique_nuclei:
@@ -4,10 +4,25 @@ through sympy"""
 import re
 
 import sympy
+from sympy.printing.cxx import CXX11CodePrinter
+from sympy.printing.precedence import PRECEDENCE
 
 from pynucastro.rates import TabularRate
 
 
+class ProductPowCodePrinter(CXX11CodePrinter):
+    """A C++ code printer that writes small positive integer powers as
+    products, e.g. x*x instead of std::pow(x, 2)"""
+
+    max_product_power = 3
+
+    def _print_Pow(self, expr):
+        if expr.exp.is_Integer and 2 <= expr.exp <= self.max_product_power:
+            base = self.parenthesize(expr.base, PRECEDENCE['Mul'])
+            return "*".join([base] * int(expr.exp))
+        return super()._print_Pow(expr)
+
+
 class SympyRates:
 
     def __init__(self):
@@ -109,6 +124,14 @@ class SympyRates:
             symbol_is_null = True
         return (jac_sym.evalf(n=self.float_explicit_num_digits), symbol_is_null)
 
+    def cxxcode(self, expr):
+        """
+        return the C++ code for expr, with the symbols replaced, writing
+        small integer powers as products
+        """
+        printer = ProductPowCodePrinter(settings={"precision": 15})
+        return self.cxxify(printer.doprint(expr))
+
     def cxxify(self, s):
         """
         Given string s, will replace the symbols appearing as keys in
@@ -1,28 +1,205 @@
 # unit tests for rates
 import filecmp
 import io
+import json
 import os
+import re
+import shutil
+import struct
+import subprocess
+import types
+import zlib
 
+import numpy as np
 import pytest
 
 from pynucastro import networks
 
+# minimal stand-ins for the AMReX headers used by the parts of the
+# network that do not need Microphysics (the tables and the profiling),
+# so they can be compiled and run here.  The arrays check their
+# bounds, so reading outside of a table aborts.
+AMREX_STUBS = {
+    "AMReX_REAL.H": """\
+#ifndef AMREX_REAL_H
+#define AMREX_REAL_H
+namespace amrex { using Real = double; }
+using amrex::Real;
+constexpr Real operator""_rt (long double x) { return static_cast<Real>(x); }
+constexpr Real operator""_rt (unsigned long long x) { return static_cast<Real>(x); }
+#define AMREX_GPU_HOST_DEVICE
+#define AMREX_GPU_MANAGED
+#define AMREX_INLINE inline
+#define AMREX_PRAGMA_SIMD
+#define HIP_CONSTEXPR constexpr
+#define MICROPHYSICS_UNUSED [[maybe_unused]]
+#endif
+""",
+    "AMReX_Array.H": """\
+#ifndef AMREX_ARRAY_H
+#define AMREX_ARRAY_H
+#include <cstdio>
+#include <cstdlib>
+#include <AMReX_REAL.H>
+inline void check_bounds (int i, int lo, int hi) {
+    if (i < lo || i > hi) { std::fprintf(stderr, "index %d out of [%d, %d]\\n", i, lo, hi); std::abort(); }
+}
+namespace amrex {
+template <class T, int XLO, int XHI>
+struct Array1D {
+    T arr[XHI-XLO+1];
+    T& operator() (int i) { check_bounds(i, XLO, XHI); return arr[i-XLO]; }
+    const T& operator() (int i) const { check_bounds(i, XLO, XHI); return arr[i-XLO]; }
+};
+template <class T, int XLO, int XHI, int YLO, int YHI, int ZLO, int ZHI>
+struct Array3D {
+    static constexpr int nx = XHI-XLO+1;
+    static constexpr int ny = YHI-YLO+1;
+    T arr[nx*ny*(ZHI-ZLO+1)];
+    T& operator() (int i, int j, int k) {
+        check_bounds(i, XLO, XHI); check_bounds(j, YLO, YHI); check_bounds(k, ZLO, ZHI);
+        return arr[(i-XLO) + nx*((j-YLO) + ny*(k-ZLO))];
+    }
+    const T& operator() (int i, int j, int k) const {
+        check_bounds(i, XLO, XHI); check_bounds(j, YLO, YHI); check_bounds(k, ZLO, ZHI);
+        return arr[(i-XLO) + nx*((j-YLO) + ny*(k-ZLO))];
+    }
+};
+}
+#endif
+""",
+    "AMReX_Print.H": """\
+#ifndef AMREX_PRINT_H
+#define AMREX_PRINT_H
+#include <iostream>
+namespace amrex { inline std::ostream& Print () { return std::cout; } }
+#endif
+""",
+    "AMReX.H": """\
+#ifndef AMREX_H
+#define AMREX_H
+#include <cstdint>
+#include <vector>
+namespace amrex {
+using Long = std::int64_t;
+inline std::vector<void (*)()> finalize_funcs;
+inline void ExecOnFinalize (void (*f)()) { finalize_funcs.push_back(f); }
+inline void Finalize () { for (auto f : finalize_funcs) { f(); } finalize_funcs.clear(); }
+}
+#endif
+""",
+    "AMReX_ParallelDescriptor.H": """\
+#ifndef AMREX_PARALLELDESCRIPTOR_H
+#define AMREX_PARALLELDESCRIPTOR_H
+#include <AMReX.H>
+namespace amrex::ParallelDescriptor {
+inline int IOProcessorNumber () { return 0; }
+inline bool IOProcessor () { return true; }
+inline void ReduceLongSum (Long*, int, int) {}
+}
+#endif
+""",
+}
+
+
+class CxxArray:
+    """ a 1-based view of storage, with the given stride and offset, as
+    the generated code uses arrays -- a(i) reads, and a[i] (which is
+    what exec_cxx turns a(i) = ... into) writes """
+
+    def __init__(self, storage, stride=1, offset=0):
+        self.storage = storage
+        self.stride = stride
+        self.offset = offset
+
+    def __call__(self, i):
+        return self.storage[(i-1) * self.stride + self.offset]
+
+    def __getitem__(self, i):
+        return self(i)
+
+    def __setitem__(self, i, value):
+        self.storage[(i-1) * self.stride + self.offset] = value
+
+
+def exec_cxx(code, namespace):
+    """ run the C++ statements written by an ftag as python, with the
+    names in namespace, and return what they return (or 0).  This only
+    handles what the ydot, Jacobian and sparse LU ftags write. """
+
+    code = re.sub(r"//.*", "", code)
+    code = re.sub(r"if \((.*?)\) \{\s*(return \w+;)\s*\}", r"if \1: \2", code)
+    code = re.sub(r"\b(const )?Real ", "", code)
+    code = re.sub(r"(\d)_rt\b", r"\1", code.replace("std::", ""))
+
+    body = []
+    for statement in code.split(";"):
+        statement = " ".join(statement.split())
+        if not statement or re.fullmatch(r"\w+", statement):
+            # a declaration
+            continue
+        body.append("    " + re.sub(r"^(\w+)\(([^()]*)\) ([-+*/]?=)", r"\1[\2] \3", statement))
+
+    exec("def _cxx():\n" + "\n".join(body) + "\n    return 0\n", namespace)  # pylint: disable=exec-used
+    return namespace["_cxx"]()
+
 
 class TestAmrexAstroCxxNetwork:
     # pylint: disable=protected-access
+    files = ["c12-c12a-ne20-cf88",
+             "c12-c12n-mg23-cf88",
+             "c12-c12p-na23-cf88",
+             "c12-ag-o16-nac2",
+             "na23--ne23-toki",
+             "ne23--na23-toki",
+             "n--p-wc12"]
+
     @pytest.fixture(scope="class")
     def fn(self):
-        files = ["c12-c12a-ne20-cf88",
-                 "c12-c12n-mg23-cf88",
-                 "c12-c12p-na23-cf88",
-                 "c12-ag-o16-nac2",
-                 "na23--ne23-toki",
-                 "ne23--na23-toki",
-                 "n--p-wc12"]
-
-        fn = networks.AmrexAstroCxxNetwork(files)
+        fn = networks.AmrexAstroCxxNetwork(self.files)
         return fn
 
+    @pytest.fixture
+    def write_with(self):
+        """ return a function that writes a new copy of the network with
+        the given optional features to test_path, and returns it """
+
+        def _write_with(test_path, **options):
+            net = networks.AmrexAstroCxxNetwork(self.files, **options)
+            net.write_network(odir=test_path)
+            return net
+
+        return _write_with
+
+    @pytest.fixture
+    def build_cxx(self):
+        """ return a function that compiles main.cpp, with the given
+        source, in a network directory (against AMREX_STUBS), and
+        returns a function that runs it and returns its output """
+
+        cxx = shutil.which(os.environ.get("CXX", "c++"))
+        if cxx is None:
+            pytest.skip("needs a C++ compiler")
+
+        def _build_cxx(test_path, source, flags=(), sources=("table_rates_data.cpp",)):
+            os.makedirs(os.path.join(test_path, "amrex_stubs"), exist_ok=True)
+            for name, text in AMREX_STUBS.items():
+                with open(os.path.join(test_path, "amrex_stubs", name), "w") as sf:
+                    sf.write(text)
+            with open(os.path.join(test_path, "main.cpp"), "w") as mf:
+                mf.write(source)
+
+            subprocess.run([cxx, "-std=c++17", "-O1", "-I", "amrex_stubs", "-I", ".", *flags,
+                            "main.cpp", *sources, "-o", "main"], cwd=test_path, check=True)
+
+            def run():
+                return subprocess.run([os.path.join(".", "main")], cwd=test_path, check=True,
+                                      capture_output=True, text=True).stdout
+
+            return run
+
+        return _build_cxx
+
     def cromulent_ftag(self, ftag, answer, n_indent=1):
         """ check to see if function ftag returns answer """
 
@@ -32,6 +209,28 @@ class TestAmrexAstroCxxNetwork:
         output.close()
         return result
 
+    @staticmethod
+    def cxx_names(net, **names):
+        """ the species and rate indices of net, with the names the
+        generated code uses for them, together with names, for exec_cxx """
+
+        namespace = {n.cindex(): i for i, n in enumerate(net.unique_nuclei, start=1)}
+        namespace.update({f"k_{r.cname()}": i for i, r in enumerate(net.all_rates, start=1)})
+        namespace.update(names)
+        return namespace
+
+    @staticmethod
+    def random_state(net, rng):
+        """ return a density, temperature and composition drawn at random """
+
+        rho = 10.0**rng.uniform(6.0, 9.0)
+        T = 10.0**rng.uniform(8.5, 9.5)
+        comp = networks.Composition(net.unique_nuclei)
+        for n in comp.X:
+            comp.X[n] = rng.uniform(0.01, 1.0)
+        comp.normalize()
+        return rho, T, comp
+
     def test_nrat_reaclib(self, fn):
         """ test the _nrat_reaclib function """
 
@@ -101,3 +300,825 @@ class TestAmrexAstroCxxNetwork:
                 errors.append(test_file)
 
         assert not errors, f"files don't match: {' '.join(errors)}"
+
+    def test_write_binary_tables(self, write_with):
+        """ test the binary tabular rate file written with binary_tables """
+        test_path = "_test_cxx_binary/"
+
+        fn = write_with(test_path, binary_tables=True)
+
+        with open(os.path.join(test_path, "Make.package")) as mf:
+            assert "CEXE_headers += table_rates_binary.H" in mf.read()
+
+        with open(os.path.join(test_path, "table_rates_binary.H")) as hf:
+            header = hf.read()
+        assert "void binary_tables_benchmark (const int nrep)" in header
+        assert "binary_table_benchmark<39, 152, 6>(blob, {39, 152, 6, 6}," in header
+        assert '"j_na23_ne23", "23Na-23Ne_electroncapture.dat", nrep);' in header
+
+        with open(os.path.join(test_path, fn.binary_table_file), "rb") as bf:
+            blob = bf.read()
+
+        magic, endian, version, ntables, checksum, nbytes = struct.unpack_from('<8sIIIIQ', blob)
+        assert magic == b'PYNUCTAB'
+        assert endian == 0x01020304
+        assert version == 1
+        assert ntables == len(fn.tabular_rates)
+        assert nbytes == len(blob)
+        assert checksum == zlib.crc32(blob[32:])
+
+        for n, r in enumerate(fn.tabular_rates):
+            name, ntemp, nrhoy, nvars, _, offset, source_size, source_mtime = \
+                struct.unpack_from('<32siiiIQQq', blob, 32 + 72*n)
+            assert name.rstrip(b'\0').decode() == r.table_index_name
+            assert (ntemp, nrhoy, nvars) == (r.table_temp_lines, r.table_rhoy_lines, r.table_num_vars)
+
+            # the ASCII table the data came from
+            source = os.stat(os.path.join(test_path, r.table_file))
+            assert (source_size, source_mtime) == (source.st_size, int(source.st_mtime))
+
+            data = np.frombuffer(blob, dtype='<f8', offset=offset,
+                                 count=nrhoy + ntemp + ntemp*nrhoy*nvars)
+            rhoy = data[:nrhoy]
+            temp = data[nrhoy:nrhoy+ntemp]
+            table = data[nrhoy+ntemp:].reshape(nvars, nrhoy, ntemp)
+
+            # every value round trips, with the ASCII rows having
+            # temperature varying fastest
+            tdata = r.tabular_data_table
+            assert np.array_equal(rhoy, tdata[::ntemp, 0])
+            assert np.array_equal(temp, tdata[:ntemp, 1])
+            assert np.array_equal(table, np.transpose(tdata[:, 2:].reshape(nrhoy, ntemp, nvars), (2, 0, 1)))
+
+    def test_read_binary_tables(self, write_with, build_cxx):
+        """ test that init_tabular() reads the same data from the binary
+        file as is in the ASCII tables, and that it falls back to an
+        ASCII table that no longer matches the binary file """
+        test_path = "_test_cxx_binary_read/"
+
+        fn = write_with(test_path, binary_tables=True)
+
+        source = "#include <cstdio>\n#include <table_rates.H>\n\nint main () {\n    init_tabular();\n"
+        for r in fn.tabular_rates:
+            t = f"rate_tables::{r.table_index_name}"
+            source += (f'    {{\n        std::FILE* f = std::fopen("{r.table_index_name}.txt", "w");\n' +
+                       f'        for (int j = 1; j <= {t}_meta.nrhoy; ++j) {{\n' +
+                       f'            for (int i = 1; i <= {t}_meta.ntemp; ++i) {{\n' +
+                       f'                std::fprintf(f, "%.17g %.17g", {t}_rhoy(j), {t}_temp(i));\n' +
+                       f'                for (int n = 1; n <= {t}_meta.nvars; ++n) {{\n' +
+                       f'                    std::fprintf(f, " %.17g", {t}_data(i, j, n));\n' +
+                       '                }\n                std::fprintf(f, "\\n");\n            }\n        }\n' +
+                       '        std::fclose(f);\n    }\n')
+        source += "}\n"
+
+        run = build_cxx(test_path, source)
+
+        def check(nbinary):
+            assert f"read 2 tables ({nbinary} from {fn.binary_table_file})" in run()
+            for r in fn.tabular_rates:
+                data = np.loadtxt(os.path.join(test_path, f"{r.table_index_name}.txt"))
+                assert np.array_equal(data, r.tabular_data_table)
+
+        check(2)
+
+        # a table that has changed since the binary file was written
+        # is read from the ASCII file instead
+        table = os.path.join(test_path, fn.tabular_rates[0].table_file)
+        mtime = os.stat(table).st_mtime
+        os.utime(table, (mtime + 10.0, mtime + 10.0))
+        check(1)
+
+    def test_fill_reaclib_rates_batch(self, fn):
+        """ test the _fill_reaclib_rates_batch function """
+
+        answer = ''
+        for r in ["c12_c12_to_he4_ne20", "c12_c12_to_n_mg23",
+                  "c12_c12_to_p_na23", "he4_c12_to_o16", "n_to_p_weak_wc12"]:
+            answer += ('    AMREX_PRAGMA_SIMD\n' +
+                       '    for (int z = 0; z < nb; ++z) {\n' +
+                       '        Real rate, drate_dT;\n' +
+                       f'        rate_{r}<do_T_derivatives>(tfactors(z), rate, drate_dT);\n' +
+                       f'        screened_rates[(k_{r}-1) * stride + z] = rate;\n' +
+                       '    }\n\n')
+
+        assert self.cromulent_ftag(fn._fill_reaclib_rates_batch, answer, n_indent=1)
+
+    @pytest.mark.parametrize("reaclib_table", [False, True])
+    def test_write_batch_rhs(self, write_with, reaclib_table):
+        """ test that the batched rhs header is only written with batch_rhs """
+        test_path = "_test_cxx_batch/"
+
+        write_with(test_path, batch_rhs=True, reaclib_table=reaclib_table)
+
+        assert os.path.isfile(os.path.join(test_path, "actual_rhs_batch.H"))
+        assert not os.path.isfile(os.path.join(test_path, "table_rates_binary.H"))
+
+        with open(os.path.join(test_path, "Make.package")) as mf:
+            assert "CEXE_headers += actual_rhs_batch.H" in mf.read()
+
+        with open(os.path.join(test_path, "actual_rhs_batch.H")) as bf:
+            batch = bf.read()
+        assert "<fill_reaclib_rates_batch>" not in batch
+        assert "rhs_nuc_batch(state, ydot_nuc, Y, rates);" in batch
+
+        # with the ReacLib rate table, the batched rates are filled from
+        # it, as the scalar rates are
+        fill = "fill_reaclib_rates<do_T_derivatives, T>(tfactors(z), rate_eval);"
+        assert (fill in batch) == reaclib_table
+        assert ("rate_he4_c12_to_o16<do_T_derivatives>(tfactors(z), rate, drate_dT);" in batch) != reaclib_table
+
+    def test_rhs_nuc_batch_values(self, fn):
+        """ evaluate the ydots of rhs_nuc_batch() for a batch of zones,
+        indexed as actual_rhs_batch() stores them, and check each zone
+        against evaluate_ydots() """
+
+        fn.compose_ydot()
+        output = io.StringIO()
+        fn._ydot(1, output)
+        ydot_code = output.getvalue()
+
+        rng = np.random.default_rng(12345)
+        nzones = 5
+        states = [self.random_state(fn, rng) for _ in range(nzones)]
+
+        # the molar fractions, rates, and ydots are stored species (or
+        # rate) by species, with the zones innermost
+        Y = np.array([[comp.get_molar()[n] for _, _, comp in states] for n in fn.unique_nuclei]).ravel()
+        rates = np.array([[r.eval(T, rho * comp.eval_ye()) for rho, T, comp in states] for r in fn.all_rates]).ravel()
+        ydot = np.zeros(len(fn.unique_nuclei) * nzones)
+
+        for z, (rho, _, _) in enumerate(states):
+            exec_cxx(ydot_code, self.cxx_names(fn, state=types.SimpleNamespace(rho=rho),
+                                               Y=CxxArray(Y, nzones, z),
+                                               screened_rates=CxxArray(rates, nzones, z),
+                                               ydot_nuc=CxxArray(ydot, nzones, z)))
+
+        for z, (rho, T, comp) in enumerate(states):
+            ydots = fn.evaluate_ydots(rho, T, comp)
+            for i, n in enumerate(fn.unique_nuclei):
+                assert ydot[i * nzones + z] == pytest.approx(ydots[n], rel=1.e-12, abs=0.0)
+
+    def test_sparse_jac(self, fn):
+        """ test the sparse Jacobian pattern and the storage written for it """
+
+        fn.compose_jacobian()
+
+        neqs = len(fn.unique_nuclei) + 1
+        nnz = len(fn.jac_lu_pattern)
+        assert len(fn.jac_pattern) == 40
+        assert fn.jac_pattern <= fn.jac_lu_pattern
+        assert sorted(fn.jac_lu_order) == list(range(neqs))
+        assert fn.jac_lu_order[-1] == neqs - 1
+
+        output = io.StringIO()
+        fn._sparse_jac_pattern(0, output)
+        pattern = output.getvalue()
+
+        def array(name):
+            values = re.search(name + r"\[[^]]*\] =\s*\{(.*?)\};", pattern, re.DOTALL).group(1)
+            return [int(v) for v in values.replace(",", " ").split()]
+
+        assert f"constexpr int jac_lu_nnz = {nnz};" in pattern
+        assert "MICROPHYSICS_UNUSED HIP_CONSTEXPR static AMREX_GPU_MANAGED int jac_lu_index[neqs*neqs] =" in pattern
+        assert array("jac_lu_order") == [k+1 for k in fn.jac_lu_order]
+
+        # the storage map has an entry for exactly the elements of the
+        # LU pattern, each stored once
+        index = np.array(array("jac_lu_index")).reshape(neqs, neqs)
+        stored = {(i, j) for i in range(neqs) for j in range(neqs) if index[i, j] >= 0}
+        assert stored == fn.jac_lu_pattern
+        assert sorted(index[index >= 0]) == list(range(nnz))
+
+        # the CSR arrays describe the same storage
+        row_ptr = array("jac_csr_row_ptr")
+        col_index = array("jac_csr_col_index")
+        assert row_ptr[0] == 0 and row_ptr[-1] == nnz
+        for i in range(neqs):
+            for p in range(row_ptr[i], row_ptr[i+1]):
+                assert index[i, col_index[p] - 1] == p
+
+        # every update in the factorization is a(i, j) -= a(i, k) * a(k, j)
+        # on stored elements
+        element = {int(index[i, j]): (i, j) for i, j in stored}
+        output = io.StringIO()
+        fn._sparse_lu_factor(0, output)
+        updates = re.findall(r"a\[(\d+)\] -= a\[(\d+)\] \* a\[(\d+)\];", output.getvalue())
+        assert updates
+        for p, q, r in updates:
+            (i, j), (iq, k), (kr, jr) = element[int(p)], element[int(q)], element[int(r)]
+            assert (iq, jr, kr) == (i, j, k)
+
+    def test_sparse_lu_solve(self, fn):
+        """ test the sparse LU factorization and solve against numpy """
+
+        fn.compose_jacobian()
+
+        neqs = len(fn.unique_nuclei) + 1
+        output = io.StringIO()
+        fn._sparse_jac_pattern(0, output)
+        values = re.search(r"jac_lu_index\[[^]]*\] =\s*\{(.*?)\};", output.getvalue(), re.DOTALL).group(1)
+        index = np.array([int(v) for v in values.replace(",", " ").split()]).reshape(neqs, neqs)
+
+        output = io.StringIO()
+        fn._sparse_lu_factor(0, output)
+        factor = output.getvalue()
+        output = io.StringIO()
+        fn._sparse_lu_solve(0, output)
+        solve = output.getvalue()
+
+        # a diagonally dominant matrix with the pattern of the Jacobian,
+        # with its rows scaled very differently, as the energy row is
+        rng = np.random.default_rng(12345)
+        A = np.zeros((neqs, neqs))
+        for i, j in fn.jac_pattern:
+            A[i, j] = rng.uniform(-1.0, 1.0)
+        A += np.diag(1.0 + np.abs(A).sum(axis=1))
+        A[-1, :] *= 1.e20
+        b = rng.uniform(-1.0, 1.0, neqs)
+
+        def lu_solve(A, b):
+            a = np.zeros(len(fn.jac_lu_pattern))
+            for i, j in fn.jac_lu_pattern:
+                a[index[i, j]] = A[i, j]
+            pivot_tol = list(np.finfo(np.float64).eps * np.abs(np.diag(A)))
+            info = exec_cxx(factor, {"a": a, "pivot_tol": pivot_tol})
+            x = b.copy()
+            if info == 0:
+                exec_cxx(solve, {"a": a, "b": CxxArray(x)})
+            return info, x
+
+        info, x = lu_solve(A, b)
+        assert info == 0
+        assert x == pytest.approx(np.linalg.solve(A, b), rel=1.e-12)
+
+        # a zero pivot is reported (1-based), rather than divided by
+        k = fn.jac_lu_order[0]
+        A[k, k] = 0.0
+        info, _ = lu_solve(A, b)
+        assert info == k + 1
+
+    def test_rhs_cse(self):
+        """ test the flux temporaries and sympy cse modes for rhs_nuc and jac_nuc """
+
+        files = ["c12-c12a-ne20-cf88",
+                 "c12-ag-o16-nac2"]
+
+        with pytest.raises(ValueError):
+            networks.AmrexAstroCxxNetwork(files, rhs_cse="bogus")
+
+        net = networks.AmrexAstroCxxNetwork(files, rhs_cse="fluxes")
+        net.compose_ydot()
+        net.compose_jacobian()
+
+        answer = ('    const Real flux_c12_c12_to_he4_ne20 = 0.5*screened_rates(k_c12_c12_to_he4_ne20)*Y(C12)*Y(C12)*state.rho;\n' +
+                  '    const Real flux_he4_c12_to_o16 = screened_rates(k_he4_c12_to_o16)*Y(C12)*Y(He4)*state.rho;\n' +
+                  '\n' +
+                  '    ydot_nuc(He4) =\n' +
+                  '        flux_c12_c12_to_he4_ne20 +\n' +
+                  '        -flux_he4_c12_to_o16;\n' +
+                  '\n' +
+                  '    ydot_nuc(C12) =\n' +
+                  '        -2.0*flux_c12_c12_to_he4_ne20 +\n' +
+                  '        -flux_he4_c12_to_o16;\n' +
+                  '\n' +
+                  '    ydot_nuc(O16) =\n' +
+                  '        flux_he4_c12_to_o16;\n' +
+                  '\n' +
+                  '    ydot_nuc(Ne20) =\n' +
+                  '        flux_c12_c12_to_he4_ne20;\n' +
+                  '\n')
+
+        assert self.cromulent_ftag(net._ydot, answer, n_indent=1)
+
+        output = io.StringIO()
+        net._jacnuc(1, output)
+        jac = output.getvalue()
+        assert '    const Real dflux_he4_c12_to_o16_dHe4 = screened_rates(k_he4_c12_to_o16)*Y(C12)*state.rho;\n' in jac
+        assert '    scratch = -2.0*dflux_c12_c12_to_he4_ne20_dC12 - dflux_he4_c12_to_o16_dC12;\n' in jac
+        assert "std::pow" not in jac
+
+        net.rhs_cse = "sympy"
+        output = io.StringIO()
+        net._ydot(1, output)
+        ydot = output.getvalue()
+        assert '    const Real cse0 = ' in ydot
+        assert ydot.count("ydot_nuc(") == 4
+        assert "std::pow" not in ydot
+
+    @pytest.mark.parametrize("rhs_cse", [None, "fluxes", "sympy"])
+    def test_rhs_cse_values(self, rhs_cse):
+        """ evaluate rhs_nuc and jac_nuc in each mode and check them
+        against evaluate_ydots() and evaluate_jacobian() """
+
+        net = networks.AmrexAstroCxxNetwork(self.files, rhs_cse=rhs_cse)
+        net.compose_ydot()
+        net.compose_jacobian()
+
+        rng = np.random.default_rng(12345)
+        rho, T, comp = self.random_state(net, rng)
+        ye = comp.eval_ye()
+
+        nspec = len(net.unique_nuclei)
+        ydot = np.zeros(nspec)
+        jac = np.zeros((nspec, nspec))
+
+        def jac_set(i, j, value):
+            jac[i-1, j-1] = value
+
+        names = self.cxx_names(net, state=types.SimpleNamespace(rho=rho),
+                               Y=CxxArray([comp.get_molar()[n] for n in net.unique_nuclei]),
+                               screened_rates=CxxArray([r.eval(T, rho * ye) for r in net.all_rates]),
+                               ydot_nuc=CxxArray(ydot), jac=types.SimpleNamespace(set=jac_set))
+
+        for ftag in (net._ydot, net._jacnuc):
+            output = io.StringIO()
+            ftag(1, output)
+            exec_cxx(output.getvalue(), names)
+
+        ydots = net.evaluate_ydots(rho, T, comp)
+        assert ydot == pytest.approx([ydots[n] for n in net.unique_nuclei], rel=1.e-12, abs=0.0)
+        assert jac == pytest.approx(net.evaluate_jacobian(rho, T, comp), rel=1.e-12, abs=0.0)
+
+    def test_grid_lookup(self, fn):
+        """ test the classification of the grids for indexed_lookup """
+
+        kind, s0, inv_ds, hints = fn.grid_lookup(np.linspace(1.0, 5.0, 17))
+        assert kind == "grid_uniform"
+        assert (s0, inv_ds, hints) == (1.0, 4.0, None)
+
+        kind, s0, inv_ds, hints = fn.grid_lookup(np.logspace(7.0, 10.0, 31))
+        assert kind == "grid_log_uniform"
+        assert s0 == pytest.approx(7.0)
+        assert inv_ds == pytest.approx(10.0)
+        assert hints is None
+
+        # the tables' grids are only piecewise uniform, so they get hints,
+        # which must never be past the cell holding the start of the hint
+        for r in fn.tabular_rates:
+            for x in fn._table_grids(r):
+                kind, s0, inv_ds, hints = fn.grid_lookup(x)
+                assert kind == "grid_general_log"
+                assert len(hints) == 128
+                s = fn.grid_log2(x)
+                assert s0 == s[0]
+                for b, h in enumerate(hints):
+                    assert 1 <= h <= len(x) - 1
+                    assert s[h-1] <= s0 + b / inv_ds
+                    assert h == len(x) - 1 or s[h] > s0 + b / inv_ds
+
+        kind, _, _, hints = fn.grid_lookup([0.0, 1.0, 1.5, 2.5, 5.0])
+        assert kind == "grid_general_lin"
+        assert hints[0] == 1 and hints[-1] == 4
+
+    def test_write_indexed_lookup(self, write_with):
+        """ test the files written with indexed_lookup """
+        test_path = "_test_cxx_indexed_lookup/"
+
+        write_with(test_path, indexed_lookup=True)
+
+        with open(os.path.join(test_path, "Make.package")) as mf:
+            assert "CEXE_headers += indexed_lookup.H" in mf.read()
+
+        with open(os.path.join(test_path, "actual_rhs.H")) as rf:
+            rhs = rf.read()
+        assert "#include <indexed_lookup.H>" in rhs
+        assert "indexed_grid(j_na23_ne23_rhoy, j_na23_ne23_rhoy_lookup)," in rhs
+        assert "void indexed_lookup_benchmark (const int nrep)" in rhs
+
+        with open(os.path.join(test_path, "indexed_lookup.H")) as lf:
+            lookup = lf.read()
+        assert "grid_lookup_t j_na23_ne23_rhoy_lookup = {grid_general_log, 152, " in lookup
+        assert "grid_lookup_t j_ne23_na23_temp_lookup = {grid_general_log, 39, " in lookup
+
+    def test_indexed_lookup_index(self, write_with, build_cxx):
+        """ test that the grid lookups find the same cell as the search,
+        at, between, just off of, and outside of the grid points """
+        test_path = "_test_cxx_indexed_lookup_index/"
+
+        fn = write_with(test_path, indexed_lookup=True)
+
+        source = """\
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <table_rates.H>
+#include <indexed_lookup.H>
+
+template <typename V>
+void check (const char* name, const grid_lookup_t& g, const V& v)
+{
+    int n = 0;
+    int nbad = 0;
+    auto test = [&] (const Real x) {
+        ++n;
+        if (grid_index_lu(g, v, x) != vector_index_lu(g.npts, v, x)) {
+            ++nbad;
+        }
+    };
+    constexpr Real inf = std::numeric_limits<Real>::infinity();
+    for (int i = 1; i <= g.npts; ++i) {
+        test(v(i));
+        test(std::nextafter(v(i), -inf));
+        test(std::nextafter(v(i), inf));
+        if (i < g.npts) {
+            for (int k = 1; k < 8; ++k) {
+                test(v(i) + 0.125_rt * k * (v(i+1) - v(i)));
+            }
+        }
+    }
+    test(0.5_rt * v(1));
+    test(2.0_rt * v(g.npts));
+    test(0.0_rt);
+    test(-1.0_rt);
+    std::printf("%s %d %d\\n", name, n, nbad);
+}
+
+int main ()
+{
+    init_tabular();
+    using namespace rate_tables;
+"""
+        grids = [f"{r.table_index_name}_{v}" for r in fn.tabular_rates for v in ("rhoy", "temp")]
+        for grid in grids:
+            source += f'    check("{grid}", {grid}_lookup, {grid});\n'
+        source += "}\n"
+
+        output = build_cxx(test_path, source)().splitlines()
+        results = {line.split()[0]: line.split()[1:] for line in output if line.split()[0] in grids}
+        assert set(results) == set(grids)
+        for n, nbad in results.values():
+            assert int(n) > 0 and int(nbad) == 0
+
+    def test_tabular_evaluate_top_cell(self, write_with, build_cxx):
+        """ test the rate and its temperature derivative from a table
+        in its last temperature cells and above the table -- there,
+        the derivative is the forward difference of the cell """
+        test_path = "_test_cxx_top_cell/"
+
+        fn = write_with(test_path)
+
+        r = fn.tabular_rates[0]
+        t = f"rate_tables::{r.table_index_name}"
+        nrhoy, ntemp = r.table_rhoy_lines, r.table_temp_lines
+        tdata = r.tabular_data_table
+        jrho = nrhoy // 2
+        rate = tdata[jrho * ntemp:(jrho + 1) * ntemp, 2 + 3]
+        temp = tdata[:ntemp, 1]
+
+        cases = [(0.5 * (temp[-3] + temp[-2]), ntemp - 3),
+                 (0.5 * (temp[-2] + temp[-1]), ntemp - 2),
+                 (temp[-1], ntemp - 2),
+                 (2.0 * temp[-1], ntemp - 2)]
+
+        source = ("#include <cstdio>\n#include <table_rates.H>\n\nint main () {\n    init_tabular();\n" +
+                  "    Real rate, drate_dt, edot_nu, edot_gamma;\n")
+        for T, _ in cases:
+            source += (f"    tabular_evaluate({t}_meta, {t}_rhoy, {t}_temp, {t}_data, {t}_rhoy({jrho + 1}), {T!r},\n" +
+                       "                     rate, drate_dt, edot_nu, edot_gamma);\n" +
+                       '    std::printf("%.17g %.17g\\n", rate, drate_dt);\n')
+        source += "}\n"
+
+        output = build_cxx(test_path, source)().splitlines()[-len(cases):]
+        for line, (T, i) in zip(output, cases):
+            slope = (rate[i+1] - rate[i]) / (temp[i+1] - temp[i])
+            rate_T, drate_dt = (float(v) for v in line.split())
+            assert rate_T == pytest.approx(rate[i] + slope * (T - temp[i]), rel=1.e-12)
+            assert drate_dt == pytest.approx(slope, rel=1.e-12)
+
+    def test_table_groups(self, fn):
+        """ test grouping the tables by their grid """
+        groups = fn._table_groups()
+        assert [[r.table_index_name for r in g] for g in groups] == [["j_na23_ne23", "j_ne23_na23"]]
+
+        with pytest.raises(ValueError):
+            networks.AmrexAstroCxxNetwork(["c12-ag-o16-nac2"], fused_tables="bogus")
+
+    @pytest.mark.parametrize("mode", [True, "compact"])
+    def test_write_fused_tables(self, write_with, mode):
+        """ test the files written with fused_tables """
+        test_path = "_test_cxx_fused_tables/"
+
+        write_with(test_path, fused_tables=mode)
+
+        with open(os.path.join(test_path, "Make.package")) as mf:
+            assert "CEXE_headers += table_rates_fused.H" in mf.read()
+
+        with open(os.path.join(test_path, "actual_rhs.H")) as rf:
+            rhs = rf.read()
+        assert "#include <table_rates_fused.H>" in rhs
+        assert "tabular_evaluate_group<2>(j_na23_ne23_meta, j_na23_ne23_rhoy, j_na23_ne23_temp, table_group_1_data," in rhs
+        assert "rate_eval.screened_rates(k_ne23_to_na23) = group_rate[1];" in rhs
+        assert "tabular_evaluate(" not in rhs
+
+        with open(os.path.join(test_path, "table_rates_data.cpp")) as tf:
+            data = tf.read()
+        assert "Array3D<Real, 1, 6, 1, 39, 1, 152> table_group_1_data;" in data
+        if mode == "compact":
+            assert "j_na23_ne23_data" not in data
+            assert "auto j_ne23_na23_group = table_group_column(table_group_1_data, 2);" in data
+        else:
+            assert "fill_table_group(table_group_1_data, 2, j_ne23_na23_meta, j_ne23_na23_data);" in data
+
+        with open(os.path.join(test_path, "table_rates_fused.H")) as ff:
+            fused = ff.read()
+        assert ("void fused_tables_benchmark (const int nrep)" in fused) == (mode is True)
+
+        # the temperature derivative is shared with get_entries()
+        assert "drate_dt[t] = get_drate_dt(table_meta, temp_table, itemp_lo, temp, rate_at);" in fused
+
+    def test_tabular_evaluate_group(self, write_with, build_cxx):
+        """ test that tabular_evaluate_group() gives the same results as
+        tabular_evaluate() for each table, from below to above the tables """
+        test_path = "_test_cxx_fused_evaluate/"
+
+        fn = write_with(test_path, fused_tables=True)
+
+        group = fn._table_groups()[0]
+        r0 = group[0]
+        tdata = r0.tabular_data_table
+        lrhoy = np.log10(tdata[::r0.table_temp_lines, 0])
+        ltemp = np.log10(tdata[:r0.table_temp_lines, 1])
+
+        source = f"""\
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <table_rates.H>
+#include <table_rates_fused.H>
+
+int main ()
+{{
+    init_tabular();
+    using namespace rate_tables;
+
+    std::mt19937 gen(12345);
+    std::uniform_real_distribution<Real> lrhoy({lrhoy[0] - 1.0!r}, {lrhoy[-1] + 1.0!r});
+    std::uniform_real_distribution<Real> ltemp({ltemp[0] - 1.0!r}, {ltemp[-1] + 1.0!r});
+
+    int n = 0;
+    int nbad = 0;
+    auto compare = [&] (const Real a, const Real b) {{
+        ++n;
+        if (std::abs(a - b) > 1.e-12_rt * std::max(std::abs(a), std::abs(b))) {{
+            ++nbad;
+        }}
+    }};
+
+    for (int k = 0; k < 10000; ++k) {{
+        const Real rhoy = std::pow(10.0_rt, lrhoy(gen));
+        const Real temp = std::pow(10.0_rt, ltemp(gen));
+
+        Real rate[{len(group)}], drate_dt[{len(group)}], edot_nu[{len(group)}], edot_gamma[{len(group)}];
+        tabular_evaluate_group<{len(group)}>({r0.table_index_name}_meta, {r0.table_index_name}_rhoy, {r0.table_index_name}_temp,
+                                table_group_1_data, rhoy, temp, rate, drate_dt, edot_nu, edot_gamma);
+
+        Real r, d, nu, g;
+"""
+        for t, r in enumerate(group):
+            name = r.table_index_name
+            source += (f"        tabular_evaluate({name}_meta, {name}_rhoy, {name}_temp, {name}_data,\n" +
+                       "                         rhoy, temp, r, d, nu, g);\n" +
+                       f"        compare(rate[{t}], r);\n        compare(drate_dt[{t}], d);\n" +
+                       f"        compare(edot_nu[{t}], nu);\n        compare(edot_gamma[{t}], g);\n")
+        source += '    }\n\n    std::printf("compared %d, differ %d\\n", n, nbad);\n}\n'
+
+        assert f"compared {10000 * 4 * len(group)}, differ 0" in build_cxx(test_path, source)()
+
+    @pytest.mark.parametrize("batch_rhs", [False, True])
+    def test_write_profile(self, write_with, batch_rhs):
+        """ test the profiling counters written with profile """
+        test_path = "_test_cxx_profile/"
+
+        write_with(test_path, profile=True, batch_rhs=batch_rhs)
+
+        with open(os.path.join(test_path, "Make.package")) as mf:
+            make = mf.read()
+        assert "CEXE_headers += network_profile.H" in make
+        assert "DEFINES += -DNETWORK_PROFILE" in make
+
+        with open(os.path.join(test_path, "network_profile.H")) as pf:
+            profile = pf.read()
+        counters = re.search(r"enum counter_t : int\n    \{\n(.*?)    \};", profile, re.DOTALL).group(1).split()
+        batch_counters = ["evaluate_rates_batch,", "actual_rhs_batch,"] if batch_rhs else []
+        assert counters == (["actual_rhs", "=", "0,", "actual_jac,"] + batch_counters +
+                            ["reaclib,", "screening,", "screen_c12_c12,", "screen_he4_c12,",
+                             "approx,", "tabular,", "tabular_j_na23_ne23,", "tabular_j_ne23_na23,",
+                             "rhs_nuc,", "jac_nuc,", "sneut5,", "NumCounters"])
+
+        # every counter that is started is stopped
+        with open(os.path.join(test_path, "actual_rhs.H")) as rf:
+            rhs = rf.read()
+        assert "#include <network_profile.H>" in rhs
+        assert "    network_profile::init();\n" in rhs
+        starts = re.findall(r"NETWORK_PROFILE_START\((\w+)\);", rhs)
+        stops = re.findall(r"NETWORK_PROFILE_STOP\((\w+)\);", rhs)
+        assert sorted(starts) == sorted(stops)
+        stages = {c.rstrip(",") for c in counters[3:-1]} | {"actual_rhs"}
+        assert set(starts) == stages - {c.rstrip(",") for c in batch_counters}
+
+        # the batched evaluations are counted under their own top level
+        # counters, so the stages within them are not outside of any
+        if batch_rhs:
+            with open(os.path.join(test_path, "actual_rhs_batch.H")) as bf:
+                batch = bf.read()
+            starts = re.findall(r"NETWORK_PROFILE_START\((\w+)\);", batch)
+            stops = re.findall(r"NETWORK_PROFILE_STOP\((\w+)\);", batch)
+            assert sorted(starts) == sorted(stops)
+            assert set(starts) == stages - {"actual_rhs", "actual_jac", "jac_nuc"}
+
+    def test_profile_counters(self, write_with, build_cxx):
+        """ test the profiling counters: the calls are counted over all
+        of the threads, and summarized once, when AMReX is finalized """
+        test_path = "_test_cxx_profile_counters/"
+
+        write_with(test_path, profile=True)
+
+        source = """\
+#include <thread>
+#include <AMReX.H>
+#include <network_profile.H>
+
+void work (const int n)
+{
+    for (int i = 0; i < n; ++i) {
+        NETWORK_PROFILE_START(actual_rhs);
+        NETWORK_PROFILE_START(rhs_nuc);
+        NETWORK_PROFILE_STOP(rhs_nuc);
+        NETWORK_PROFILE_STOP(actual_rhs);
+    }
+}
+
+int main ()
+{
+    network_profile::init();
+    network_profile::init();
+    std::thread t(work, 3);
+    work(4);
+    t.join();
+    amrex::Finalize();
+}
+"""
+        output = build_cxx(test_path, source, flags=("-DNETWORK_PROFILE", "-pthread"), sources=())()
+        assert output.count("network profile") == 1
+        calls = dict(re.findall(r"^ +(\w+) +(\d+) ", output, re.MULTILINE))
+        assert calls == {"actual_rhs": "7", "rhs_nuc": "7"}
+
+        # without NETWORK_PROFILE, the counters are compiled out
+        assert build_cxx(test_path, source, flags=("-pthread",), sources=())() == ""
+
+    def test_reaclib_table_npts(self, fn):
+        """ test that the ReacLib rate table meets its tolerance """
+        npts, err = fn.reaclib_table_npts()
+        assert err <= 0.5 * fn.reaclib_table_rtol
+        assert npts <= fn.reaclib_table_max_npts
+
+        # a tighter tolerance needs more points
+        rtol = fn.reaclib_table_rtol
+        fine = networks.AmrexAstroCxxNetwork(self.files, reaclib_table_rtol=1.e-3 * rtol)
+        npts_fine, err_fine = fine.reaclib_table_npts()
+        assert npts_fine > npts
+        assert err_fine <= 0.5e-3 * rtol
+
+    def test_reaclib_table_error(self, fn):
+        """ test the interpolation error of a table with the number of
+        points chosen for the network, using the rates from pynucastro """
+
+        npts, _ = fn.reaclib_table_npts()
+        x, dx = np.linspace(*np.log(fn.reaclib_table_T9_range), npts, retstep=True)
+
+        def ln_rate(r, lnT9):
+            return np.log([r.eval(1.e9 * T9) for T9 in np.exp(lnT9)])
+
+        rng = np.random.default_rng(12345)
+        xs = rng.uniform(x[0], x[-1], 5000)
+        i = np.minimum(((xs - x[0]) / dx).astype(int), npts - 2)
+        t = (xs - x[i]) / dx
+
+        h = 1.e-4
+        for r in fn.reaclib_rates + fn.derived_rates:
+            # the rates underflow to zero at the lowest temperatures
+            with np.errstate(divide="ignore", invalid="ignore"):
+                y = ln_rate(r, x)
+                m = (ln_rate(r, x + h) - ln_rate(r, x - h)) / (2.0 * h)
+
+                # the cubic Hermite interpolant of ln(rate) in ln(T9)
+                y_interp = ((2*t**3 - 3*t**2 + 1) * y[i] + (t**3 - 2*t**2 + t) * dx * m[i] +
+                            (3*t**2 - 2*t**3) * y[i+1] + (t**3 - t**2) * dx * m[i+1])
+
+            rate = np.exp(ln_rate(r, xs))
+            ok = np.isfinite(y_interp)
+            err = np.abs(np.exp(y_interp[ok]) - rate[ok]) / np.maximum(rate[ok], fn.reaclib_table_min_rate)
+            assert err.max() <= fn.reaclib_table_rtol
+
+            # the rates only underflow far below reaclib_table_min_rate
+            assert np.all(rate[~ok] < fn.reaclib_table_min_rate)
+
+    def test_write_reaclib_table(self, write_with):
+        """ test the ReacLib rate table written with reaclib_table """
+        test_path = "_test_cxx_reaclib_table/"
+
+        write_with(test_path, reaclib_table=True)
+
+        with open(os.path.join(test_path, "Make.package")) as mf:
+            make = mf.read()
+        assert "CEXE_headers += reaclib_table.H" in make
+        assert "CEXE_sources += reaclib_table_data.cpp" in make
+
+        with open(os.path.join(test_path, "reaclib_table.H")) as tf:
+            table = tf.read()
+        index = re.search(r"MICROPHYSICS_UNUSED HIP_CONSTEXPR static AMREX_GPU_MANAGED int "
+                          r"reaclib_table_rate_index\[NrateReaclib\] = \{\n(.*?)\};", table, re.DOTALL).group(1).split()
+        assert index == ["k_c12_c12_to_he4_ne20,", "k_c12_c12_to_n_mg23,", "k_c12_c12_to_p_na23,",
+                         "k_he4_c12_to_o16,", "k_n_to_p_weak_wc12"]
+
+        with open(os.path.join(test_path, "reaclib_rates.H")) as rf:
+            rates = rf.read()
+        assert "#include <reaclib_table.H>" in rates
+        assert "if (fill_reaclib_rates_tabulated<do_T_derivatives, T>(tfactors, rate_eval)) {" in rates
+
+        with open(os.path.join(test_path, "actual_rhs.H")) as rf:
+            rhs = rf.read()
+        assert "    init_tabular();\n    init_reaclib_table();\n" in rhs
+
+    def test_write_reaclib_table_no_reaclib(self):
+        """ test that reaclib_table is ignored if the network has no
+        ReacLib rates when it is written """
+        test_path = "_test_cxx_reaclib_table_none/"
+
+        net = networks.AmrexAstroCxxNetwork(self.files, reaclib_table=True)
+        net.remove_rates(net.reaclib_rates + net.derived_rates)
+        with pytest.warns(UserWarning, match="no ReacLib rates"):
+            net.write_network(odir=test_path)
+
+        assert not os.path.exists(os.path.join(test_path, "reaclib_table.H"))
+        with open(os.path.join(test_path, "reaclib_rates.H")) as rf:
+            assert "reaclib_table" not in rf.read()
+
+        # the option itself is left as it was set
+        assert net.reaclib_table
+        assert not net.reaclib_table_enabled
+
+    def test_write_benchmark(self, write_with):
+        """ test the standalone benchmark written with benchmark """
+        test_path = "_test_cxx_benchmark/"
+
+        net = write_with(test_path, benchmark=True)
+
+        # the benchmark has its own main(), so it is not part of the network
+        with open(os.path.join(test_path, "Make.package")) as mf:
+            make = mf.read()
+        assert "network_benchmark.cpp" not in make
+
+        # it is built with the Microphysics unit test harness instead,
+        # with this directory as the network
+        with open(os.path.join(test_path, "GNUmakefile")) as gf:
+            gnumake = gf.read()
+        assert "NETWORK_DIR := $(CURDIR)" in gnumake
+        assert "Bpack   := ./Make.benchmark" in gnumake
+        assert "include $(MICROPHYSICS_HOME)/unit_test/Make.unit_test" in gnumake
+        with open(os.path.join(test_path, "Make.benchmark")) as bf:
+            assert "CEXE_sources += network_benchmark.cpp" in bf.read()
+
+        with open(os.path.join(test_path, "network_benchmark.cpp")) as bf:
+            bench = bf.read()
+        assert "int main (int argc, char* argv[])" in bench
+        options = re.search(r'benchmark_network_options = R"\((.*)\)";', bench).group(1)
+        assert json.loads(options) == net.benchmark_options()
+        assert json.loads(options)["rhs_cse"] is None
+
+    def test_benchmark_make(self, write_with):
+        """ test that the GNUmakefile written with benchmark builds with
+        the Microphysics unit test harness, with this network """
+        test_path = "_test_cxx_benchmark_make/"
+
+        make = shutil.which("make")
+        if make is None:
+            pytest.skip("needs make")
+
+        write_with(test_path, benchmark=True)
+
+        # a stand-in for the harness that reports what it was given
+        home = os.path.abspath(os.path.join(test_path, "microphysics"))
+        os.makedirs(os.path.join(home, "unit_test"), exist_ok=True)
+        with open(os.path.join(home, "unit_test", "Make.unit_test"), "w") as mf:
+            mf.write("include $(Bpack)\n" +
+                     "all:\n" +
+                     "\t@echo EBASE=$(EBASE)\n" +
+                     "\t@echo NETWORK_DIR=$(NETWORK_DIR)\n" +
+                     "\t@echo USE_OMP=$(USE_OMP) USE_CUDA=$(USE_CUDA) USE_HIP=$(USE_HIP)\n" +
+                     "\t@echo CEXE_sources=$(CEXE_sources)\n" +
+                     "\t@echo LIBRARIES=$(LIBRARIES)\n")
+
+        result = subprocess.run([make, f"MICROPHYSICS_HOME={home}"], cwd=test_path,
+                                check=True, capture_output=True, text=True)
+        output = dict(line.split("=", 1) for line in result.stdout.splitlines())
+        assert output["EBASE"] == "network_benchmark"
+        assert os.path.samefile(output["NETWORK_DIR"], test_path)
+        assert output["CEXE_sources"].split() == ["network_benchmark.cpp"]
+        assert "-pthread" in output["LIBRARIES"].split()
+
+        # it needs to know where Microphysics is
+        env = {k: v for k, v in os.environ.items() if k != "MICROPHYSICS_HOME"}
+        result = subprocess.run([make], cwd=test_path, env=env, check=False, capture_output=True, text=True)
+        assert result.returncode != 0
+        assert "MICROPHYSICS_HOME must be set" in result.stderr